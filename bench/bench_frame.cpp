@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Microbenchmark for the per-frame kernels in src/frame.cpp.
+ *
+ * Each kernel is timed over synthetic frame mixes shaped like real traffic:
+ * a clean 32kB dump, a dump with resync garbage and short frames, and the
+ * 20 byte adapter command frames. Results are reported in ns/frame. The
+ * upset check from src/upset_monitor.h is timed on filled dumps as well.
+ *
+ * Usage: bin/radmon-bench [-r REPEATS] [-s SEED]
+ */
+
+// Includes
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+#include "logger.h"
+#include "tracer.h"
+#include "upset_monitor.h"
+
+using namespace std;
+
+// Constants
+#define BENCH_DUMP_FRAMES 8193 /* frames in a full FRAM dump */
+#define BENCH_REPEATS_DEFAULT 20
+#define BENCH_SEED_DEFAULT 1
+#define BENCH_WRITE_CHUNK_SIZE 65536 /* bytes, output batch for format_dump_frame */
+#define BENCH_UPSET_EVERY 64  /* frames per flipped bit in the upset mix */
+
+// Type Definitions
+struct FrameMix {
+  string name;
+  vector<unsigned char> stream;          /* raw bytes as read from the tty */
+  vector<unsigned char> frames;          /* CANUSB_FRAME_BUFFER_SIZE per frame */
+  vector<int> frame_lens;
+};
+
+// Global Variables
+static volatile int sink;
+
+
+// Function Prototypes
+static void add_frame(FrameMix& mix, const unsigned char *frame, int frame_len);
+static void add_data_frame(FrameMix& mix, mt19937& rng, int dlc);
+static void add_command_frame(FrameMix& mix, mt19937& rng);
+static FrameMix make_clean_dump(mt19937& rng);
+static FrameMix make_noisy_dump(mt19937& rng);
+static FrameMix make_command_frames(mt19937& rng);
+template <typename F> static double time_per_frame(int repeats, int frame_count, F&& kernel);
+static void report(const char *kernel, const FrameMix& mix, double ns_per_frame);
+static void bench_mix(const FrameMix& mix, int repeats);
+static bool check_dump_format(const FrameMix& mix);
+static void bench_hex(int repeats);
+static void bench_trace(int repeats);
+static void bench_upset(int repeats);
+
+
+
+int main(int argc, char *argv[])
+{
+  int c;
+  int repeats = BENCH_REPEATS_DEFAULT;
+  unsigned int seed = BENCH_SEED_DEFAULT;
+
+  while ((c = getopt(argc, argv, "hr:s:")) != -1) {
+    switch (c) {
+    case 'r':
+      repeats = atoi(optarg);
+      break;
+
+    case 's':
+      seed = atoi(optarg);
+      break;
+
+    case 'h':
+    case '?':
+    default:
+      fprintf(stderr, "Usage: %s [-r REPEATS] [-s SEED]\n", argv[0]);
+      return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  if (repeats < 1) {
+    repeats = 1;
+  }
+
+  /* print_frame() logs every frame, and the echo kernels print to stdout. */
+  char log_path[] = "/dev/null";
+  logger.set_log_path(log_path);
+  if (freopen("/dev/null", "w", stdout) == NULL) {
+    perror("freopen");
+    return EXIT_FAILURE;
+  }
+
+  mt19937 rng(seed);
+  vector<FrameMix> mixes;
+  mixes.push_back(make_clean_dump(rng));
+  mixes.push_back(make_noisy_dump(rng));
+  mixes.push_back(make_command_frames(rng));
+
+  fprintf(stderr, "%-20s %-14s %8s %12s %10s\n", "kernel", "mix", "frames", "ns/frame", "Mframe/s");
+  for (const FrameMix& mix : mixes) {
+    if (!check_dump_format(mix)) {
+      return EXIT_FAILURE;
+    }
+    bench_mix(mix, repeats);
+  }
+  bench_hex(repeats);
+  bench_trace(repeats);
+  bench_upset(repeats);
+
+  return EXIT_SUCCESS;
+}
+
+
+
+// Function Definitions
+static void add_frame(FrameMix& mix, const unsigned char *frame, int frame_len)
+{
+  mix.stream.insert(mix.stream.end(), frame, frame + frame_len);
+  size_t offset = mix.frames.size();
+  mix.frames.resize(offset + CANUSB_FRAME_BUFFER_SIZE, 0x00);
+  for (int i = 0; i < frame_len; i++) {
+    mix.frames[offset + i] = frame[i];
+  }
+  mix.frame_lens.push_back(frame_len);
+}
+
+
+
+static void add_data_frame(FrameMix& mix, mt19937& rng, int dlc)
+{
+  unsigned char frame[CANUSB_FRAME_BUFFER_SIZE];
+  int frame_len = 0;
+
+  frame[frame_len++] = 0xaa;
+  frame[frame_len++] = 0xc0 | dlc;
+  frame[frame_len++] = 0x11; /* CANUSB_RECEIVE_ID_DEFAULT lsb */
+  frame[frame_len++] = 0x00; /* CANUSB_RECEIVE_ID_DEFAULT msb */
+  for (int i = 0; i < dlc; i++) {
+    frame[frame_len++] = rng() & 0xff;
+  }
+  frame[frame_len++] = 0x55;
+  add_frame(mix, frame, frame_len);
+}
+
+
+
+static void add_command_frame(FrameMix& mix, mt19937& rng)
+{
+  unsigned char frame[20];
+  int frame_len = 0;
+
+  frame[frame_len++] = 0xaa;
+  frame[frame_len++] = 0x55;
+  while (frame_len < 19) {
+    frame[frame_len++] = rng() & 0xff;
+  }
+  frame[frame_len++] = generate_checksum(&frame[2], 17);
+  add_frame(mix, frame, frame_len);
+}
+
+
+
+static FrameMix make_clean_dump(mt19937& rng)
+{
+  FrameMix mix;
+  mix.name = "dump-clean";
+  for (int i = 0; i < BENCH_DUMP_FRAMES; i++) {
+    add_data_frame(mix, rng, 8);
+  }
+  return mix;
+}
+
+
+
+/* Roughly what a dump looks like when the host drops bytes: one in fifty
+ * frames is replaced by a lone out-of-sync byte, and a few are short. */
+static FrameMix make_noisy_dump(mt19937& rng)
+{
+  FrameMix mix;
+  mix.name = "dump-noisy";
+  for (int i = 0; i < BENCH_DUMP_FRAMES; i++) {
+    int roll = rng() % 100;
+    if (roll < 2) {
+      unsigned char garbage = 0x01 + (rng() % 0xa8);
+      add_frame(mix, &garbage, 1);
+    } else if (roll < 4) {
+      add_data_frame(mix, rng, 1 + (rng() % 7));
+    } else {
+      add_data_frame(mix, rng, 8);
+    }
+  }
+  return mix;
+}
+
+
+
+static FrameMix make_command_frames(mt19937& rng)
+{
+  FrameMix mix;
+  mix.name = "command";
+  for (int i = 0; i < 1024; i++) {
+    add_command_frame(mix, rng);
+  }
+  return mix;
+}
+
+
+
+/* Best of `repeats` runs, so scheduler noise does not inflate the result. */
+template <typename F> static double time_per_frame(int repeats, int frame_count, F&& kernel)
+{
+  double best = 0;
+  for (int r = 0; r < repeats; r++) {
+    auto start = chrono::steady_clock::now();
+    kernel();
+    auto stop = chrono::steady_clock::now();
+    double ns = chrono::duration<double, nano>(stop - start).count() / frame_count;
+    if (r == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+
+
+static void report(const char *kernel, const FrameMix& mix, double ns_per_frame)
+{
+  fprintf(stderr, "%-20s %-14s %8zu %12.1f %10.2f\n",
+          kernel, mix.name.c_str(), mix.frame_lens.size(), ns_per_frame, 1000.0 / ns_per_frame);
+}
+
+
+
+static void bench_mix(const FrameMix& mix, int repeats)
+{
+  int frame_count = mix.frame_lens.size();
+  double ns;
+
+  /* Fed one byte at a time, exactly as save_frame() does. */
+  ns = time_per_frame(repeats, frame_count, [&]() {
+    unsigned char frame[CANUSB_FRAME_BUFFER_SIZE];
+    int frame_len = 0, frames = 0;
+    for (unsigned char byte : mix.stream) {
+      frame[frame_len++] = byte;
+      if (frame_is_complete(frame, frame_len)) {
+        frames++;
+        frame_len = 0;
+      }
+    }
+    sink = frames;
+  });
+  report("frame_is_complete", mix, ns);
+
+  ns = time_per_frame(repeats, frame_count, [&]() {
+    int checksum = 0;
+    for (int i = 0; i < frame_count; i++) {
+      checksum ^= generate_checksum(&mix.frames[i * CANUSB_FRAME_BUFFER_SIZE + 2], 17);
+    }
+    sink = checksum;
+  });
+  report("generate_checksum", mix, ns);
+
+  ns = time_per_frame(repeats, frame_count, [&]() {
+    for (int i = 0; i < frame_count; i++) {
+      print_frame(const_cast<unsigned char *>(&mix.frames[i * CANUSB_FRAME_BUFFER_SIZE]));
+    }
+  });
+  report("print_frame", mix, ns);
+
+  ns = time_per_frame(repeats, frame_count, [&]() {
+    for (int i = 0; i < frame_count; i++) {
+      print_dump_frame(&mix.frames[i * CANUSB_FRAME_BUFFER_SIZE], mix.frame_lens[i]);
+    }
+  });
+  report("print_dump_frame", mix, ns);
+
+  ofstream dump_file("/dev/null");
+  ns = time_per_frame(repeats, frame_count, [&]() {
+    for (int i = 0; i < frame_count; i++) {
+      write_dump_frame(dump_file, &mix.frames[i * CANUSB_FRAME_BUFFER_SIZE], mix.frame_lens[i]);
+    }
+    dump_file.flush();
+  });
+  report("write_dump_frame", mix, ns);
+
+  /* What save_frame() did per frame before format_dump_frame(). */
+  ostringstream dump_record;
+  ns = time_per_frame(repeats, frame_count, [&]() {
+    size_t total = 0;
+    for (int i = 0; i < frame_count; i++) {
+      dump_record.str("");
+      write_dump_frame(dump_record, &mix.frames[i * CANUSB_FRAME_BUFFER_SIZE], mix.frame_lens[i]);
+      total += dump_record.view().size();
+    }
+    sink = total;
+  });
+  report("write_dump_frame/ss", mix, ns);
+
+  /* Formatted into one reusable buffer and written in large chunks. */
+  int null_fd = open("/dev/null", O_WRONLY);
+  vector<char> chunk(BENCH_WRITE_CHUNK_SIZE);
+  ns = time_per_frame(repeats, frame_count, [&]() {
+    size_t used = 0;
+    for (int i = 0; i < frame_count; i++) {
+      if (used > chunk.size() - DUMP_LINE_SIZE) {
+        sink = write(null_fd, chunk.data(), used);
+        used = 0;
+      }
+      used += format_dump_frame(&chunk[used], &mix.frames[i * CANUSB_FRAME_BUFFER_SIZE], mix.frame_lens[i]);
+    }
+    sink = write(null_fd, chunk.data(), used);
+  });
+  close(null_fd);
+  report("format_dump_frame", mix, ns);
+}
+
+
+
+/* The fast formatter is only worth having if downstream scripts cannot tell
+ * the difference, so it is checked against the iostream layout first. */
+static bool check_dump_format(const FrameMix& mix)
+{
+  ostringstream expected;
+  string actual;
+  char line[DUMP_LINE_SIZE];
+
+  for (size_t i = 0; i < mix.frame_lens.size(); i++) {
+    write_dump_frame(expected, &mix.frames[i * CANUSB_FRAME_BUFFER_SIZE], mix.frame_lens[i]);
+    actual.append(line, format_dump_frame(line, &mix.frames[i * CANUSB_FRAME_BUFFER_SIZE], mix.frame_lens[i]));
+  }
+  if (expected.view() != actual) {
+    fprintf(stderr, "format_dump_frame output differs from write_dump_frame on %s\n", mix.name.c_str());
+    return false;
+  }
+  return true;
+}
+
+
+
+/* The hex strings send_data_frame() parses for each command. */
+static void bench_hex(int repeats)
+{
+  const char *hex_strings[] = { "01", "EF", "02", "04", "AA67D53FAA" };
+  const int count = sizeof(hex_strings) / sizeof(hex_strings[0]);
+  const int rounds = 4096;
+  FrameMix mix;
+  double ns;
+
+  mix.name = "commands";
+  mix.frame_lens.resize(count * rounds);
+
+  ns = time_per_frame(repeats, count * rounds, [&]() {
+    unsigned char bin_string[8];
+    int total = 0;
+    for (int r = 0; r < rounds; r++) {
+      for (int i = 0; i < count; i++) {
+        total += convert_from_hex(hex_strings[i], bin_string, sizeof(bin_string));
+      }
+    }
+    sink = total;
+  });
+  report("convert_from_hex", mix, ns);
+
+  mix.name = "hex-digits";
+  mix.frame_lens.resize(256 * rounds);
+  ns = time_per_frame(repeats, 256 * rounds, [&]() {
+    int total = 0;
+    for (int r = 0; r < rounds; r++) {
+      for (int c = 0; c < 256; c++) {
+        total += hex_value(c);
+      }
+    }
+    sink = total;
+  });
+  report("hex_value", mix, ns);
+}
+
+
+
+/* Cost of one TRACE_SPAN, which wraps every read batch and write in the
+ * serial path: with tracing off it must stay near zero. */
+static void bench_trace(int repeats)
+{
+  const int rounds = 4096;
+  FrameMix mix;
+  double ns;
+
+  mix.frame_lens.resize(rounds);
+  for (bool is_enabled : { false, true }) {
+    trace_enabled = is_enabled;
+    mix.name = is_enabled ? "tracing-on" : "tracing-off";
+    ns = time_per_frame(repeats, rounds, [&]() {
+      for (int r = 0; r < rounds; r++) {
+        TRACE_SPAN("bench", "bench");
+        sink = r;
+      }
+    });
+    report("TRACE_SPAN", mix, ns);
+  }
+  trace_enabled = false;
+}
+
+
+
+/* check() on every frame of a filled dump, clean and with an upset in one
+ * frame in BENCH_UPSET_EVERY. Alerts are off so only the counting is timed. */
+static void bench_upset(int repeats)
+{
+  mt19937 rng(BENCH_SEED_DEFAULT);
+  UpsetMonitor monitor;
+  FrameMix mix;
+  double ns;
+
+  monitor.is_enabled = true;
+  monitor.spec.threshold = 0;
+  monitor.spec.burst_flips = 0;
+  mix.frames.assign(BENCH_DUMP_FRAMES * CANUSB_FRAME_BUFFER_SIZE, 0xff);
+  mix.frame_lens.assign(BENCH_DUMP_FRAMES, 13);
+
+  for (bool is_upset : { false, true }) {
+    mix.name = is_upset ? "fill-upsets" : "fill-clean";
+    for (int i = 0; is_upset && i < BENCH_DUMP_FRAMES; i += BENCH_UPSET_EVERY) {
+      mix.frames[i * CANUSB_FRAME_BUFFER_SIZE + 4 + rng() % 8] ^= 1 << (rng() % 8);
+    }
+    ns = time_per_frame(repeats, BENCH_DUMP_FRAMES, [&]() {
+      monitor.begin(UPSET_FILL_PATTERN, "bench");
+      for (int i = 0; i < BENCH_DUMP_FRAMES; i++) {
+        monitor.check(i, &mix.frames[i * CANUSB_FRAME_BUFFER_SIZE + 4]);
+      }
+      sink = monitor.flips;
+    });
+    report("UpsetMonitor::check", mix, ns);
+  }
+}
@@ -0,0 +1,495 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <asm/termbits.h> /* struct termios2 */
+#include <ctype.h>
+#include <libgen.h>
+#include <poll.h>
+#include <linux/limits.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include "canusb.h"
+#include "frame.h"
+#include "logger.h"
+#include "tracer.h"
+
+using namespace std;
+
+// Global Variables
+int print_traffic = 0;
+static mutex send_mutex; /* keeps frames from concurrent senders whole on the wire */
+
+
+// Function Prototypes
+static bool is_hung_up(int tty_fd);
+
+
+
+// Function Definitions
+CANUSB_SPEED canusb_int_to_speed(int speed)
+{
+  switch (speed) {
+  case 1000000:
+    return CANUSB_SPEED_1000000;
+  case 800000:
+    return CANUSB_SPEED_800000;
+  case 500000:
+    return CANUSB_SPEED_500000;
+  case 400000:
+    return CANUSB_SPEED_400000;
+  case 250000:
+    return CANUSB_SPEED_250000;
+  case 200000:
+    return CANUSB_SPEED_200000;
+  case 125000:
+    return CANUSB_SPEED_125000;
+  case 100000:
+    return CANUSB_SPEED_100000;
+  case 50000:
+    return CANUSB_SPEED_50000;
+  case 20000:
+    return CANUSB_SPEED_20000;
+  case 10000:
+    return CANUSB_SPEED_10000;
+  case 5000:
+    return CANUSB_SPEED_5000;
+  default:
+    return (CANUSB_SPEED)0; /* the adapter has no such speed */
+  }
+}
+
+
+
+/* Inverse of canusb_int_to_speed; 0 for a code the adapter does not know. */
+int canusb_speed_to_int(CANUSB_SPEED speed)
+{
+  static const int speeds[] = {
+    0, 1000000, 800000, 500000, 400000, 250000, 200000, 125000, 100000, 50000, 20000, 10000, 5000,
+  };
+
+  if (speed < CANUSB_SPEED_1000000 || speed > CANUSB_SPEED_5000) {
+    return 0;
+  }
+  return speeds[speed];
+}
+
+
+
+/* Safe to call from several threads: each frame is written, and echoed when
+ * print_traffic is set, under one lock. */
+int frame_send(int tty_fd, const unsigned char *frame, int frame_len)
+{
+  int result, i;
+  char temp_string[4095];
+  lock_guard<mutex> lock(send_mutex);
+
+  if (print_traffic) {
+    printf(">>> ");
+    sprintf(debug_output, ">>> ");
+    for (i = 0; i < frame_len; i++) {
+      printf("%02x ", frame[i]);
+      sprintf(temp_string, "%02x ", frame[i]);
+      strcat(debug_output, temp_string);
+    }
+    if (print_traffic > 1) {
+      printf("    '");
+      sprintf(temp_string, "    '");
+      strcat(debug_output, temp_string);
+      for (i = 4; i < frame_len - 1; i++) {
+        printf("%c", isalnum(frame[i]) ? frame[i] : '.');
+        sprintf(temp_string, "%c", isalnum(frame[i]) ? frame[i] : '.');
+        strcat(debug_output, temp_string);
+      }
+      printf("'");
+      sprintf(temp_string, "'");
+      strcat(debug_output, temp_string);
+    }
+    printf("\n");
+    logger.log(debug_output, INFO);
+  }
+
+  TraceSpan span("write", "serial");
+  span.arg = frame_len;
+  result = write(tty_fd, frame, frame_len);
+  if (result == -1) {
+    int write_errno = errno;
+    fprintf(stderr, "write() failed: %s\n", strerror(errno));
+    errno = write_errno; /* callers check is_device_lost(errno) */
+    return -1;
+  }
+
+  return frame_len;
+}
+
+
+
+int command_settings(int tty_fd, CANUSB_SPEED speed, CANUSB_MODE mode, CANUSB_FRAME frame)
+{
+  int cmd_frame_len;
+  unsigned char cmd_frame[20];
+
+  cmd_frame_len = 0;
+  cmd_frame[cmd_frame_len++] = 0xaa;
+  cmd_frame[cmd_frame_len++] = 0x55;
+  cmd_frame[cmd_frame_len++] = 0x12;
+  cmd_frame[cmd_frame_len++] = speed;
+  cmd_frame[cmd_frame_len++] = frame;
+  cmd_frame[cmd_frame_len++] = 0; /* Filter ID not handled. */
+  cmd_frame[cmd_frame_len++] = 0; /* Filter ID not handled. */
+  cmd_frame[cmd_frame_len++] = 0; /* Filter ID not handled. */
+  cmd_frame[cmd_frame_len++] = 0; /* Filter ID not handled. */
+  cmd_frame[cmd_frame_len++] = 0; /* Mask ID not handled. */
+  cmd_frame[cmd_frame_len++] = 0; /* Mask ID not handled. */
+  cmd_frame[cmd_frame_len++] = 0; /* Mask ID not handled. */
+  cmd_frame[cmd_frame_len++] = 0; /* Mask ID not handled. */
+  cmd_frame[cmd_frame_len++] = mode;
+  cmd_frame[cmd_frame_len++] = 0x01;
+  cmd_frame[cmd_frame_len++] = 0;
+  cmd_frame[cmd_frame_len++] = 0;
+  cmd_frame[cmd_frame_len++] = 0;
+  cmd_frame[cmd_frame_len++] = 0;
+  cmd_frame[cmd_frame_len++] = generate_checksum(&cmd_frame[2], 17);
+
+  if (frame_send(tty_fd, cmd_frame, cmd_frame_len) < 0) {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+
+void clear_buffer(int tty_fd)
+{
+  int is_buffer_filled = 1;
+  int result;
+  unsigned char byte;
+
+  while (is_buffer_filled) {
+    result = read(tty_fd, &byte, 1);
+    if (result != 1) {
+      is_buffer_filled = 0;
+      return;
+    }
+    traced_usleep(2);
+  }
+  return;
+}
+
+
+
+int adapter_init(const char *tty_device, int baudrate)
+{
+  int tty_fd, result;
+  struct termios2 tio;
+
+  tty_fd = open(tty_device, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (tty_fd == -1) {
+    fprintf(stderr, "open(%s) failed: %s\n", tty_device, strerror(errno));
+    return -1;
+  }
+
+  result = ioctl(tty_fd, TCGETS2, &tio);
+  if (result == -1) {
+    fprintf(stderr, "ioctl() failed: %s\n", strerror(errno));
+    close(tty_fd);
+    return -1;
+  }
+
+  tio.c_cflag &= ~CBAUD;
+  tio.c_cflag = BOTHER | CS8 | CSTOPB;
+  tio.c_iflag = IGNPAR;
+  tio.c_oflag = 0;
+  tio.c_lflag = 0;
+  tio.c_ispeed = baudrate;
+  tio.c_ospeed = baudrate;
+
+  result = ioctl(tty_fd, TCSETS2, &tio);
+  if (result == -1) {
+    fprintf(stderr, "ioctl() failed: %s\n", strerror(errno));
+    close(tty_fd);
+    return -1;
+  }
+
+  return tty_fd;
+}
+
+
+
+/* Reads the driver's interrupt counters. Not every tty implements
+ * TIOCGICOUNT (ptys and some USB-serial drivers do not), so callers must
+ * treat -1 as "unknown" rather than as a failure. */
+int adapter_get_icount(int tty_fd, struct serial_icounter_struct *icount)
+{
+  if (ioctl(tty_fd, TIOCGICOUNT, icount) == -1) {
+    return -1;
+  }
+
+  return 0;
+}
+
+
+
+/* Opt-in receive path tuning: driver low-latency flag, USB-serial latency
+ * timer, and blocking reads that return as soon as bytes arrive (VMIN 0)
+ * or after CANUSB_LOW_LATENCY_VTIME with nothing. Only the termios step is
+ * required; the other two depend on the driver and are skipped with a
+ * warning when unsupported. */
+int adapter_set_low_latency(int tty_fd, const char *tty_device)
+{
+  struct serial_struct serial;
+  struct termios2 tio;
+  char resolved_path[PATH_MAX];
+  char sysfs_path[320];
+  int flags;
+
+  if (ioctl(tty_fd, TIOCGSERIAL, &serial) == -1) {
+    sprintf(debug_output, "TIOCGSERIAL failed (%s), ASYNC_LOW_LATENCY not set", strerror(errno));
+    logger.log(debug_output, WARN);
+  } else {
+    serial.flags |= ASYNC_LOW_LATENCY;
+    if (ioctl(tty_fd, TIOCSSERIAL, &serial) == -1) {
+      sprintf(debug_output, "TIOCSSERIAL failed (%s), ASYNC_LOW_LATENCY not set", strerror(errno));
+      logger.log(debug_output, WARN);
+    } else {
+      logger.log("ASYNC_LOW_LATENCY set", INFO);
+    }
+  }
+
+  if (realpath(tty_device, resolved_path) != NULL) {
+    snprintf(sysfs_path, sizeof(sysfs_path), "/sys/bus/usb-serial/devices/%s/latency_timer", basename(resolved_path));
+    FILE *latency_timer = fopen(sysfs_path, "w");
+    if (latency_timer == NULL) {
+      snprintf(debug_output, sizeof(debug_output), "No USB-serial latency timer at %s (%s)", sysfs_path, strerror(errno));
+      logger.log(debug_output, WARN);
+    } else {
+      fprintf(latency_timer, "%d\n", CANUSB_LATENCY_TIMER_MS);
+      if (fclose(latency_timer) == 0) {
+        sprintf(debug_output, "USB-serial latency timer set to %d ms", CANUSB_LATENCY_TIMER_MS);
+        logger.log(debug_output, INFO);
+      } else {
+        sprintf(debug_output, "Unable to set USB-serial latency timer: %s", strerror(errno));
+        logger.log(debug_output, WARN);
+      }
+    }
+  }
+
+  flags = fcntl(tty_fd, F_GETFL);
+  if (flags == -1 || fcntl(tty_fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+    fprintf(stderr, "fcntl() failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  if (ioctl(tty_fd, TCGETS2, &tio) == -1) {
+    fprintf(stderr, "ioctl() failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = CANUSB_LOW_LATENCY_VTIME;
+
+  if (ioctl(tty_fd, TCSETS2, &tio) == -1) {
+    fprintf(stderr, "ioctl() failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  sprintf(debug_output, "Blocking reads with VMIN 0, VTIME %d", CANUSB_LOW_LATENCY_VTIME);
+  logger.log(debug_output, INFO);
+  return 0;
+}
+
+
+
+/* Returns 1 once tty_fd has bytes to read, 0 on timeout and -1 on error. */
+int wait_readable(int tty_fd, int timeout_ms)
+{
+  struct pollfd pfd = {};
+  int result;
+
+  pfd.fd = tty_fd;
+  pfd.events = POLLIN;
+  do {
+    result = poll(&pfd, 1, timeout_ms);
+  } while (result == -1 && errno == EINTR);
+
+  if (result > 0 && !(pfd.revents & POLLIN)) {
+    return -1;
+  }
+  return result;
+}
+
+
+
+/* The errors read() and write() give once a USB-serial adapter is unplugged
+ * or reset. */
+bool is_device_lost(int error)
+{
+  return error == EIO || error == ENODEV || error == ENXIO;
+}
+
+
+
+/* Opens the device again with the current baudrate, low-latency profile,
+ * speed and mode, and moves the new descriptor onto tty_fd. */
+int AdapterLink::reopen()
+{
+  int new_fd = adapter_init(tty_device, baudrate);
+
+  if (new_fd == -1) {
+    return -1;
+  }
+  if ((is_low_latency && adapter_set_low_latency(new_fd, tty_device) == -1)
+      || command_settings(new_fd, speed, mode, CANUSB_FRAME_STANDARD) == -1
+      || dup3(new_fd, tty_fd, O_CLOEXEC) == -1) {
+    close(new_fd);
+    return -1;
+  }
+  close(new_fd);
+  return 0;
+}
+
+
+
+/* Reopens the device with backoff until it is back or reconnect_timeout_s
+ * passes. */
+int AdapterLink::reconnect()
+{
+  struct timespec start, now;
+  int delay_ms = CANUSB_RECONNECT_BACKOFF_MIN_MS;
+
+  sprintf(debug_output, "Adapter %s lost, reconnecting for up to %d s", tty_device, reconnect_timeout_s);
+  logger.log(debug_output, WARN);
+  fprintf(stderr, "%s\n", debug_output);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  do {
+    traced_usleep(delay_ms * 1000);
+    delay_ms = min(delay_ms * 2, CANUSB_RECONNECT_BACKOFF_MAX_MS);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (access(tty_device, R_OK | W_OK) == -1 || reopen() == -1) {
+      continue;
+    }
+
+    reconnects++;
+    sprintf(debug_output, "Adapter %s reconnected after %ld s", tty_device, now.tv_sec - start.tv_sec);
+    logger.log(debug_output, INFO);
+    fprintf(stderr, "%s\n", debug_output);
+    return 0;
+  } while (now.tv_sec - start.tv_sec < reconnect_timeout_s);
+
+  sprintf(debug_output, "Adapter %s did not come back within %d s", tty_device, reconnect_timeout_s);
+  logger.log(debug_output, ERROR);
+  fprintf(stderr, "%s\n", debug_output);
+  return -1;
+}
+
+
+
+SerialReader::SerialReader(int tty_fd)
+  : tty_fd(tty_fd)
+{
+}
+
+
+
+/* Same return convention as read(tty_fd, byte, 1), except that a hung-up
+ * tty, which reads as end of file forever, fails with ENODEV. */
+int SerialReader::read_byte(unsigned char *byte)
+{
+  if (head == tail) {
+    TraceSpan span("read", "serial");
+    int result = read(tty_fd, buffer, sizeof(buffer));
+    span.arg = result;
+    if (result == 0 && is_hung_up(tty_fd)) {
+      errno = ENODEV;
+      return -1;
+    }
+    if (result <= 0) {
+      return result;
+    }
+    head = 0;
+    tail = result;
+  }
+
+  *byte = buffer[head++];
+  return 1;
+}
+
+
+
+bool SerialReader::is_empty() const
+{
+  return head == tail;
+}
+
+
+
+void SerialReader::reset()
+{
+  head = tail = 0;
+}
+
+
+
+/* Parses a 1 to 3 digit hex string into an 11-bit standard CAN ID. */
+int parse_can_id(const char *hex_id, unsigned short *id)
+{
+  int len = strlen(hex_id);
+  int value = 0;
+
+  if (len < 1 || len > 3) {
+    return -1;
+  }
+
+  for (int i = 0; i < len; i++) {
+    if (hex_value(hex_id[i]) < 0) {
+      return -1;
+    }
+    value = (value * 16) + hex_value(hex_id[i]);
+  }
+
+  if (value > 0x7ff) {
+    return -1;
+  }
+
+  *id = value;
+  return 0;
+}
+
+
+
+/* poll() reports POLLHUP on a tty whose device has gone away. */
+static bool is_hung_up(int tty_fd)
+{
+  struct pollfd pfd = {};
+
+  pfd.fd = tty_fd;
+  pfd.events = POLLIN;
+  return poll(&pfd, 1, 0) == 1 && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL));
+}
+
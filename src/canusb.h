@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_CANUSB_H
+#define RADMON_CANUSB_H
+
+// Includes
+#include <linux/serial.h> /* struct serial_icounter_struct */
+
+// Constants
+#define CANUSB_INJECT_SLEEP_GAP_DEFAULT 200 /* ms */
+#define CANUSB_CAN_SPEED_DEFAULT 500000
+#define CANUSB_TTY_BAUD_RATE_DEFAULT 2000000
+#define CANUSB_DATA_FRAME_MAX_SIZE 13 /* 0xaa, info, 2 ID bytes, 8 data bytes, 0x55 */
+#define CANUSB_READ_BUFFER_SIZE 4096
+#define CANUSB_LOW_LATENCY_VTIME 1 /* deciseconds a blocking read waits for the first byte */
+#define CANUSB_LATENCY_TIMER_MS 1  /* FTDI-style USB-serial latency timer */
+#define CANUSB_RECONNECT_TIMEOUT_DEFAULT 60 /* s, 0 disables reconnecting */
+#define CANUSB_RECONNECT_BACKOFF_MIN_MS 100
+#define CANUSB_RECONNECT_BACKOFF_MAX_MS 2000
+
+// Type Definitions
+typedef enum {
+  CANUSB_SPEED_1000000 = 0x01,
+  CANUSB_SPEED_800000  = 0x02,
+  CANUSB_SPEED_500000  = 0x03,
+  CANUSB_SPEED_400000  = 0x04,
+  CANUSB_SPEED_250000  = 0x05,
+  CANUSB_SPEED_200000  = 0x06,
+  CANUSB_SPEED_125000  = 0x07,
+  CANUSB_SPEED_100000  = 0x08,
+  CANUSB_SPEED_50000   = 0x09,
+  CANUSB_SPEED_20000   = 0x0a,
+  CANUSB_SPEED_10000   = 0x0b,
+  CANUSB_SPEED_5000    = 0x0c,
+} CANUSB_SPEED;
+
+typedef enum {
+  CANUSB_MODE_NORMAL          = 0x00,
+  CANUSB_MODE_LOOPBACK        = 0x01,
+  CANUSB_MODE_SILENT          = 0x02,
+  CANUSB_MODE_LOOPBACK_SILENT = 0x03,
+} CANUSB_MODE;
+
+typedef enum {
+  CANUSB_FRAME_STANDARD = 0x01,
+  CANUSB_FRAME_EXTENDED = 0x02,
+} CANUSB_FRAME;
+
+typedef enum {
+  CANUSB_INJECT_PAYLOAD_MODE_RANDOM      = 0,
+  CANUSB_INJECT_PAYLOAD_MODE_INCREMENTAL = 1,
+  CANUSB_INJECT_PAYLOAD_MODE_FIXED       = 2,
+} CANUSB_PAYLOAD_MODE;
+
+/* A standard ID data frame exactly as written to the adapter. */
+struct CanusbDataFrame {
+  unsigned char bytes[CANUSB_DATA_FRAME_MAX_SIZE];
+  int len;
+};
+
+/* Reads the tty in large chunks and hands out one byte at a time, so the
+ * frame parsers keep their byte-wise loops without a syscall per byte. */
+class SerialReader {
+  public:
+    int tty_fd;
+
+    SerialReader(int tty_fd);
+    int read_byte(unsigned char *byte);
+    bool is_empty() const;
+    void reset();
+
+  private:
+    unsigned char buffer[CANUSB_READ_BUFFER_SIZE];
+    int head = 0;
+    int tail = 0;
+};
+
+/* What it takes to bring the adapter back after it drops off USB (reset or
+ * re-enumeration), or to move it to other settings. reopen() opens the
+ * device onto the same descriptor number, so every copy of tty_fd stays
+ * valid. */
+struct AdapterLink {
+  int tty_fd;
+  const char *tty_device;
+  int baudrate;
+  CANUSB_SPEED speed;
+  CANUSB_MODE mode = CANUSB_MODE_NORMAL;
+  bool is_low_latency = false;
+  int reconnect_timeout_s = CANUSB_RECONNECT_TIMEOUT_DEFAULT;
+  int reconnects = 0;
+
+  int reopen();
+  int reconnect();
+};
+
+// Global Variables
+extern int print_traffic;
+
+// Function Prototypes
+CANUSB_SPEED canusb_int_to_speed(int speed);
+int canusb_speed_to_int(CANUSB_SPEED speed);
+int frame_send(int tty_fd, const unsigned char *frame, int frame_len);
+int command_settings(int tty_fd, CANUSB_SPEED speed, CANUSB_MODE mode, CANUSB_FRAME frame);
+void clear_buffer(int tty_fd);
+int adapter_init(const char *tty_device, int baudrate);
+int adapter_get_icount(int tty_fd, struct serial_icounter_struct *icount);
+int adapter_set_low_latency(int tty_fd, const char *tty_device);
+int wait_readable(int tty_fd, int timeout_ms);
+bool is_device_lost(int error);
+int parse_can_id(const char *hex_id, unsigned short *id);
+
+// Inline Definitions
+constexpr CanusbDataFrame encode_data_frame(unsigned short id, const unsigned char *data, int data_len)
+{
+  CanusbDataFrame frame = {};
+
+  /* Byte 0: Packet Start */
+  frame.bytes[frame.len++] = 0xaa;
+
+  /* Byte 1: CAN Bus Data Frame Information */
+  /* Bit 7 and 6 always 1, bit 5 0=STD frame, bit 4 0=Data, bits 3-0 DLC */
+  frame.bytes[frame.len++] = 0xc0 | (data_len & 0x0f);
+
+  /* Byte 2 to 3: ID */
+  frame.bytes[frame.len++] = id & 0xff; /* lsb */
+  frame.bytes[frame.len++] = (id >> 8) & 0xff; /* msb */
+
+  /* Byte 4 to (4+data_len): Data */
+  for (int i = 0; i < data_len; i++)
+    frame.bytes[frame.len++] = data[i];
+
+  /* Last byte: End of frame */
+  frame.bytes[frame.len++] = 0x55;
+
+  return frame;
+}
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <stdio.h>
+
+#include <chrono>
+
+#include "dashboard.h"
+#include "realtime.h"
+
+using namespace std;
+
+
+
+// Function Definitions
+void DumpStats::reset(int frame_count)
+{
+  frames_expected.store(frame_count, memory_order_relaxed);
+  frames_received.store(0, memory_order_relaxed);
+  frames_intact.store(0, memory_order_relaxed);
+  checksum_errors.store(0, memory_order_relaxed);
+  unknown_frames.store(0, memory_order_relaxed);
+  read_errors.store(0, memory_order_relaxed);
+  bytes_received.store(0, memory_order_relaxed);
+  uart_overruns.store(0, memory_order_relaxed);
+  framing_errors.store(0, memory_order_relaxed);
+  parity_errors.store(0, memory_order_relaxed);
+  buffer_overruns.store(0, memory_order_relaxed);
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  start_ns.store(now.tv_sec * 1000000000L + now.tv_nsec, memory_order_relaxed);
+}
+
+
+
+double DumpStats::elapsed() const
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec * 1000000000L + now.tv_nsec - start_ns.load(memory_order_relaxed)) / 1e9;
+}
+
+
+
+/* Starts the renderer thread. Only that thread writes to the terminal, so a
+ * slow console never stalls the serial loop filling in the stats. */
+void Dashboard::start(const DumpStats *stats, string label)
+{
+  stop();
+  this->stats = stats;
+  this->label = label;
+  running = true;
+  renderer = thread(&Dashboard::run, this);
+}
+
+
+
+void Dashboard::stop()
+{
+  if (!renderer.joinable()) {
+    return;
+  }
+  running = false;
+  renderer.join();
+  render(true);
+}
+
+
+
+Dashboard::~Dashboard()
+{
+  stop();
+}
+
+
+
+void Dashboard::render(bool is_final)
+{
+  int expected = stats->frames_expected.load(memory_order_relaxed);
+  int received = stats->frames_received.load(memory_order_relaxed);
+  long bytes = stats->bytes_received.load(memory_order_relaxed);
+  double elapsed = stats->elapsed();
+  double frame_rate = elapsed > 0 ? received / elapsed : 0;
+  double byte_rate = elapsed > 0 ? bytes / elapsed : 0;
+  char eta_string[20];
+
+  if (received >= expected) {
+    sprintf(eta_string, "done");
+  } else if (frame_rate > 0) {
+    sprintf(eta_string, "%.0fs", (expected - received) / frame_rate);
+  } else {
+    sprintf(eta_string, "--");
+  }
+
+  int serial_drops = stats->uart_overruns.load(memory_order_relaxed)
+                     + stats->buffer_overruns.load(memory_order_relaxed);
+
+  fprintf(stderr, "\r\033[K[%s] %d/%d frames  %.1f kB/s  ETA %s  checksum errors %d  unknown %d  read errors %d  serial drops %d%s",
+          label.c_str(), received, expected, byte_rate / 1000, eta_string,
+          stats->checksum_errors.load(memory_order_relaxed),
+          stats->unknown_frames.load(memory_order_relaxed),
+          stats->read_errors.load(memory_order_relaxed),
+          serial_drops,
+          is_final ? "\n" : "");
+}
+
+
+
+void Dashboard::run()
+{
+  release_thread_realtime();
+  while (running) {
+    this_thread::sleep_for(chrono::milliseconds(DASHBOARD_REFRESH_MS));
+    if (running) {
+      render(false);
+    }
+  }
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_DASHBOARD_H
+#define RADMON_DASHBOARD_H
+
+// Includes
+#include <time.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+// Constants
+#define DASHBOARD_REFRESH_MS 250
+
+// Type Definitions
+/* Counters for the dump in progress. Written by the serial loop, read by the
+ * dashboard renderer, so every field is a relaxed atomic. */
+struct DumpStats {
+  std::atomic<int> frames_expected{0};
+  std::atomic<int> frames_received{0};
+  std::atomic<int> frames_intact{0};   /* whole data frames from the dumping payload, before any repair */
+  std::atomic<int> checksum_errors{0};
+  std::atomic<int> unknown_frames{0};
+  std::atomic<int> read_errors{0};
+  std::atomic<long> bytes_received{0};
+  std::atomic<int> uart_overruns{0};   /* TIOCGICOUNT deltas since the dump command */
+  std::atomic<int> framing_errors{0};
+  std::atomic<int> parity_errors{0};
+  std::atomic<int> buffer_overruns{0};
+  std::atomic<long> start_ns{0};       /* CLOCK_MONOTONIC */
+
+  void reset(int frame_count);
+  double elapsed() const;
+};
+
+class Dashboard {
+  public:
+    void start(const DumpStats *stats, std::string label);
+    void stop();
+    ~Dashboard();
+
+  private:
+    const DumpStats *stats = nullptr;
+    std::string label;
+    std::atomic<bool> running{false};
+    std::thread renderer;
+
+    void render(bool is_final);
+    void run();
+};
+
+#endif
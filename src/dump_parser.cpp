@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <string.h>
+
+#include "dump_parser.h"
+
+using namespace std;
+
+// Type Definitions
+struct HexTable {
+  signed char value[256];
+
+  constexpr HexTable() : value()
+  {
+    for (int c = 0; c < 256; c++) {
+      value[c] = -1;
+    }
+    for (int c = '0'; c <= '9'; c++) {
+      value[c] = c - '0';
+    }
+    for (int c = 'a'; c <= 'f'; c++) {
+      value[c] = c - 'a' + 10;
+      value[c - 'a' + 'A'] = c - 'a' + 10;
+    }
+  }
+};
+
+// Global Variables
+static constexpr HexTable hex_table;
+
+
+// Function Prototypes
+static const char *parse_hex(const char *p, const char *end, unsigned int *value);
+static const char *skip_spaces(const char *p, const char *end);
+static bool starts_with(const char *p, const char *end, const char *prefix, size_t prefix_len);
+
+
+
+// Function Definitions
+/* Parses the layout written by write_dump_frame():
+ *   "Frame ID: <id>, Data: xx xx xx xx xx xx xx xx \n\0"
+ *   "Unknown: x xx x ... \n"
+ * The ID and unknown bytes are unpadded hex, and data lines are followed by
+ * the NUL from `<< ends`, which here is skipped at the start of a line. */
+void parse_dump_text(const char *text, size_t text_len, ParsedDump& dump)
+{
+  const char *p = text;
+  const char *end = text + text_len;
+
+  dump.records.reserve(dump.records.size() + text_len / 46 + 1);
+
+  while (p < end) {
+    while (p < end && *p == '\0') {
+      p++;
+    }
+    if (p >= end) {
+      break;
+    }
+
+    const char *line_end = (const char *)memchr(p, '\n', end - p);
+    if (line_end == NULL) {
+      line_end = end;
+    }
+
+    DumpRecord record = {};
+    unsigned int value;
+    bool is_valid = false;
+
+    if (starts_with(p, line_end, "Frame ID: ", 10)) {
+      const char *q = parse_hex(p + 10, line_end, &value);
+      if (q != NULL && starts_with(q, line_end, ", Data: ", 8)) {
+        record.type = DUMP_RECORD_DATA;
+        record.id = value;
+        q += 8;
+        int n = 0;
+        if (line_end - q == 24) {
+          /* Fast path: the padded "xx " layout, decoded two digits at a time. */
+          for (; n < 8; n++) {
+            int high = hex_table.value[(unsigned char)q[3 * n]];
+            int low = hex_table.value[(unsigned char)q[3 * n + 1]];
+            if (high < 0 || low < 0 || q[3 * n + 2] != ' ') {
+              break;
+            }
+            record.data[n] = (high << 4) | low;
+          }
+        }
+        if (n < 8) {
+          n = 0;
+          while (n < 8 && (q = parse_hex(skip_spaces(q, line_end), line_end, &value)) != NULL) {
+            record.data[n++] = value;
+          }
+        }
+        record.len = n;
+        is_valid = (n == 8);
+      }
+    } else if (starts_with(p, line_end, "Unknown: ", 9)) {
+      const char *q = p + 9;
+      int n = 0;
+      record.type = DUMP_RECORD_UNKNOWN;
+      while ((q = parse_hex(skip_spaces(q, line_end), line_end, &value)) != NULL) {
+        if (n < 8) {
+          record.data[n] = value;
+        }
+        n++;
+      }
+      record.len = n > 255 ? 255 : n;
+      is_valid = true;
+    }
+
+    if (is_valid) {
+      dump.records.push_back(record);
+      if (record.type == DUMP_RECORD_DATA) {
+        dump.data_frames++;
+      } else {
+        dump.unknown_frames++;
+      }
+    } else if (line_end > p) {
+      dump.malformed_lines++;
+    }
+
+    p = line_end + 1;
+  }
+}
+
+
+
+/* Returns the position after the hex digits, or NULL if there were none. */
+static const char *parse_hex(const char *p, const char *end, unsigned int *value)
+{
+  const char *start = p;
+  unsigned int result = 0;
+
+  while (p < end && hex_table.value[(unsigned char)*p] >= 0) {
+    result = (result << 4) | hex_table.value[(unsigned char)*p];
+    p++;
+  }
+
+  if (p == start) {
+    return NULL;
+  }
+  *value = result;
+  return p;
+}
+
+
+
+static const char *skip_spaces(const char *p, const char *end)
+{
+  while (p < end && *p == ' ') {
+    p++;
+  }
+  return p;
+}
+
+
+
+static bool starts_with(const char *p, const char *end, const char *prefix, size_t prefix_len)
+{
+  return (size_t)(end - p) >= prefix_len && memcmp(p, prefix, prefix_len) == 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_DUMP_PARSER_H
+#define RADMON_DUMP_PARSER_H
+
+// Includes
+#include <stddef.h>
+
+#include <vector>
+
+// Constants
+#define DUMP_RECORD_DATA    0
+#define DUMP_RECORD_UNKNOWN 1
+
+// Type Definitions
+/* One line of a text dump. Unknown lines keep their first 8 bytes; len is
+ * the number of bytes the line actually had. */
+struct DumpRecord {
+  unsigned char type;
+  unsigned char len;
+  unsigned short id;
+  unsigned char data[8];
+};
+
+struct ParsedDump {
+  std::vector<DumpRecord> records;
+  int data_frames = 0;
+  int unknown_frames = 0;
+  int malformed_lines = 0;
+};
+
+// Function Prototypes
+void parse_dump_text(const char *text, size_t text_len, ParsedDump& dump);
+
+#endif
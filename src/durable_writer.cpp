@@ -0,0 +1,414 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+
+#include "durable_writer.h"
+#include "logger.h"
+#include "tracer.h"
+
+using namespace std;
+
+// Type Definitions
+struct Crc32Table {
+  unsigned int value[256];
+
+  constexpr Crc32Table() : value()
+  {
+    for (unsigned int n = 0; n < 256; n++) {
+      unsigned int c = n;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      }
+      value[n] = c;
+    }
+  }
+};
+
+// Global Variables
+static constexpr Crc32Table crc32_table;
+
+
+// Function Prototypes
+static int fsync_parent_dir(const char *path);
+
+
+
+// Function Definitions
+/* Standard CRC-32 (as zlib's crc32()), chained by passing the previous result. */
+unsigned int crc32_update(unsigned int crc, const void *data, size_t len)
+{
+  const unsigned char *p = (const unsigned char *)data;
+
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc = crc32_table.value[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+
+
+int DurableWriter::open(const char *path)
+{
+  string temp_path = string(path) + DURABLE_TEMP_SUFFIX;
+  string index_path = string(path) + DURABLE_INDEX_SUFFIX DURABLE_TEMP_SUFFIX;
+
+  close();
+  data_fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (data_fd == -1) {
+    fprintf(stderr, "open(%s) failed: %s\n", temp_path.c_str(), strerror(errno));
+    return -1;
+  }
+  index_fd = ::open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (index_fd == -1) {
+    fprintf(stderr, "open(%s) failed: %s\n", index_path.c_str(), strerror(errno));
+    ::close(data_fd);
+    data_fd = -1;
+    return -1;
+  }
+
+  final_path = path;
+  buffer.reserve(DURABLE_BUFFER_SIZE);
+  offset = 0;
+  file_crc = 0;
+  uncommitted_records = 0;
+  clock_gettime(CLOCK_MONOTONIC, &last_commit);
+  return 0;
+}
+
+
+
+int DurableWriter::open_append(const char *path)
+{
+  close();
+  data_fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (data_fd == -1) {
+    fprintf(stderr, "open(%s) failed: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  final_path.clear();
+  uncommitted_records = 0;
+  clock_gettime(CLOCK_MONOTONIC, &last_commit);
+  return 0;
+}
+
+
+
+int DurableWriter::write_record(string_view record)
+{
+  if (data_fd == -1) {
+    return -1;
+  }
+
+  buffer.append(record);
+  if (index_fd != -1) {
+    char index_line[64];
+    unsigned int crc = crc32_update(0, record.data(), record.size());
+    snprintf(index_line, sizeof(index_line), "%lu %zu %08x\n", offset, record.size(), crc);
+    index_buffer.append(index_line);
+    file_crc = crc32_update(file_crc, record.data(), record.size());
+  }
+  offset += record.size();
+  uncommitted_records++;
+
+  if (uncommitted_records >= commit_records) {
+    return commit();
+  }
+  if (ms_until_commit() == 0) {
+    return commit();
+  }
+
+  if (buffer.size() >= DURABLE_BUFFER_SIZE) {
+    return flush();
+  }
+  return 0;
+}
+
+
+
+/* For a writer waiting on its input: records already written are committed
+ * once commit_ms has passed, even if no further record comes to trigger it. */
+int DurableWriter::commit_if_due()
+{
+  if (data_fd == -1 || uncommitted_records == 0 || ms_until_commit() > 0) {
+    return 0;
+  }
+  return commit();
+}
+
+
+
+/* How long until the time-based commit is due, 0 if it already is. */
+int DurableWriter::ms_until_commit() const
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long since_commit_ms = (now.tv_sec - last_commit.tv_sec) * 1000 + (now.tv_nsec - last_commit.tv_nsec) / 1000000;
+  return since_commit_ms >= commit_ms ? 0 : (int)(commit_ms - since_commit_ms);
+}
+
+
+
+/* Hands buffered records to the kernel without waiting for the disk. The
+ * data goes before its index lines, so an index entry never points past
+ * data that was written. */
+int DurableWriter::flush()
+{
+  TraceSpan span("flush", "file");
+  span.arg = buffer.size();
+  if (write_all(data_fd, buffer) == -1) {
+    return -1;
+  }
+  buffer.clear();
+
+  if (index_fd != -1) {
+    if (write_all(index_fd, index_buffer) == -1) {
+      return -1;
+    }
+    index_buffer.clear();
+  }
+  return 0;
+}
+
+
+
+int DurableWriter::commit()
+{
+  if (data_fd == -1) {
+    return -1;
+  }
+  if (flush() == -1) {
+    return -1;
+  }
+  /* EINVAL means the file cannot be synced at all (/dev/null, a pipe), so
+   * there is nothing to wait for. */
+  TRACE_SPAN("fdatasync", "file");
+  if ((fdatasync(data_fd) == -1 && errno != EINVAL)
+      || (index_fd != -1 && fdatasync(index_fd) == -1 && errno != EINVAL)) {
+    fprintf(stderr, "fdatasync() failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  uncommitted_records = 0;
+  clock_gettime(CLOCK_MONOTONIC, &last_commit);
+  return 0;
+}
+
+
+
+int DurableWriter::close()
+{
+  int result = 0;
+
+  if (data_fd == -1) {
+    return 0;
+  }
+
+  if (index_fd != -1) {
+    char trailer[64];
+    snprintf(trailer, sizeof(trailer), "end %lu %08x\n", offset, file_crc);
+    index_buffer.append(trailer);
+  }
+  if (commit() == -1) {
+    result = -1;
+  }
+
+  ::close(data_fd);
+  data_fd = -1;
+  if (index_fd != -1) {
+    ::close(index_fd);
+    index_fd = -1;
+
+    string temp_path = final_path + DURABLE_TEMP_SUFFIX;
+    string index_path = final_path + DURABLE_INDEX_SUFFIX;
+    string temp_index_path = index_path + DURABLE_TEMP_SUFFIX;
+    /* The index goes first: a crash between the two renames leaves an index
+     * whose data file is missing, which verifies as torn, never a complete
+     * looking data file without one. */
+    if (result == 0 && rename(temp_index_path.c_str(), index_path.c_str()) == -1) {
+      fprintf(stderr, "rename(%s) failed: %s\n", temp_index_path.c_str(), strerror(errno));
+      result = -1;
+    }
+    if (result == 0 && rename(temp_path.c_str(), final_path.c_str()) == -1) {
+      fprintf(stderr, "rename(%s) failed: %s\n", temp_path.c_str(), strerror(errno));
+      result = -1;
+    }
+    if (result == 0) {
+      result = fsync_parent_dir(final_path.c_str());
+    }
+  }
+
+  buffer.clear();
+  index_buffer.clear();
+  return result;
+}
+
+
+
+/* Closes without the rename: a file from open() is deleted along with its
+ * index, so nothing appears under the final name. */
+void DurableWriter::discard()
+{
+  if (data_fd == -1) {
+    return;
+  }
+
+  ::close(data_fd);
+  data_fd = -1;
+  if (index_fd != -1) {
+    ::close(index_fd);
+    index_fd = -1;
+    unlink((final_path + DURABLE_TEMP_SUFFIX).c_str());
+    unlink((final_path + DURABLE_INDEX_SUFFIX DURABLE_TEMP_SUFFIX).c_str());
+  }
+
+  buffer.clear();
+  index_buffer.clear();
+}
+
+
+
+bool DurableWriter::is_open() const
+{
+  return data_fd != -1;
+}
+
+
+
+/* A writer destroyed without close() (an abandoned dump) commits what it
+ * has but leaves it under the .part name. */
+DurableWriter::~DurableWriter()
+{
+  if (data_fd == -1) {
+    return;
+  }
+  commit();
+  ::close(data_fd);
+  if (index_fd != -1) {
+    ::close(index_fd);
+  }
+}
+
+
+
+int DurableWriter::write_all(int fd, const string& data)
+{
+  size_t written = 0;
+
+  while (written < data.size()) {
+    ssize_t result = write(fd, data.data() + written, data.size() - written);
+    if (result == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "write() failed: %s\n", strerror(errno));
+      return -1;
+    }
+    written += result;
+  }
+  return 0;
+}
+
+
+
+static int fsync_parent_dir(const char *path)
+{
+  char dir_path[PATH_MAX];
+
+  snprintf(dir_path, sizeof(dir_path), "%s", path);
+  int dir_fd = ::open(dirname(dir_path), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd == -1) {
+    return -1;
+  }
+  int result = fsync(dir_fd);
+  ::close(dir_fd);
+  return result;
+}
+
+
+
+/* Checks every indexed record of path against its CRC, then the trailer. */
+DURABLE_STATE durable_verify(const char *path, const char *index_path)
+{
+  FILE *index_file = fopen(index_path, "r");
+  if (index_file == NULL) {
+    /* Writers that renamed the data file first could leave its index
+     * behind under the temporary name. */
+    string temp_index_path = string(index_path) + DURABLE_TEMP_SUFFIX;
+    return access(temp_index_path.c_str(), F_OK) == 0 ? DURABLE_TORN : DURABLE_NO_INDEX;
+  }
+
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    if (fd != -1) {
+      ::close(fd);
+    }
+    fclose(index_file);
+    return DURABLE_TORN;
+  }
+
+  const unsigned char *data = NULL;
+  if (st.st_size > 0) {
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    data = mapped == MAP_FAILED ? NULL : (const unsigned char *)mapped;
+  }
+  ::close(fd);
+  if (st.st_size > 0 && data == NULL) {
+    fclose(index_file);
+    return DURABLE_TORN;
+  }
+
+  DURABLE_STATE state = DURABLE_TORN;
+  unsigned long record_offset, record_len, expected_offset = 0;
+  unsigned int crc;
+  char line[128];
+
+  while (fgets(line, sizeof(line), index_file) != NULL) {
+    if (sscanf(line, "end %lu %x", &record_len, &crc) == 2) {
+      if (record_len == expected_offset && record_len == (unsigned long)st.st_size
+          && crc32_update(0, data, st.st_size) == crc) {
+        state = DURABLE_CLEAN;
+      }
+      break;
+    }
+    if (sscanf(line, "%lu %lu %x", &record_offset, &record_len, &crc) != 3
+        || record_offset != expected_offset
+        || record_offset + record_len > (unsigned long)st.st_size
+        || crc32_update(0, data + record_offset, record_len) != crc) {
+      break;
+    }
+    expected_offset = record_offset + record_len;
+  }
+
+  if (data != NULL) {
+    munmap((void *)data, st.st_size);
+  }
+  fclose(index_file);
+  return state;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_DURABLE_WRITER_H
+#define RADMON_DURABLE_WRITER_H
+
+// Includes
+#include <stddef.h>
+#include <time.h>
+
+#include <string>
+#include <string_view>
+
+// Constants
+#define DURABLE_COMMIT_RECORDS_DEFAULT 1024 /* fsync after this many records... */
+#define DURABLE_COMMIT_MS_DEFAULT 500       /* ...or once this much time has passed */
+#define DURABLE_BUFFER_SIZE 65536
+#define DURABLE_TEMP_SUFFIX ".part"
+#define DURABLE_INDEX_SUFFIX ".sum"
+
+// Type Definitions
+typedef enum {
+  DURABLE_CLEAN     = 0, /* trailer present and every record checks out */
+  DURABLE_TORN      = 1, /* a record or the trailer is missing or corrupt */
+  DURABLE_NO_INDEX  = 2, /* written before the index existed */
+} DURABLE_STATE;
+
+/* Writes a file in records with group-commit durability: records are
+ * buffered and fsync()ed every commit_records records or commit_ms, and on
+ * close().
+ *
+ * open() writes to <path>.part and a checksum index to <path>.sum.part, one
+ * "<offset> <length> <crc32>" line per record. close() appends an
+ * "end <length> <crc32>" trailer and renames both into place, index first,
+ * so a file under its final name is always complete; discard() abandons it
+ * instead. A writer that can stall between records calls commit_if_due()
+ * while it waits.
+ * open_append() is for logs: no rename and no index, only the group commit. */
+class DurableWriter {
+  public:
+    int commit_records = DURABLE_COMMIT_RECORDS_DEFAULT;
+    int commit_ms = DURABLE_COMMIT_MS_DEFAULT;
+
+    DurableWriter() = default;
+    DurableWriter(const DurableWriter&) = delete;
+    DurableWriter& operator=(const DurableWriter&) = delete;
+    int open(const char *path);
+    int open_append(const char *path);
+    int write_record(std::string_view record);
+    int flush();
+    int commit();
+    int commit_if_due();
+    int close();
+    void discard();
+    bool is_open() const;
+    ~DurableWriter();
+
+  private:
+    int data_fd = -1;
+    int index_fd = -1;
+    std::string final_path;
+    std::string buffer;
+    std::string index_buffer;
+    unsigned long offset = 0;
+    unsigned int file_crc = 0;
+    int uncommitted_records = 0;
+    struct timespec last_commit = {};
+
+    int write_all(int fd, const std::string& data);
+    int ms_until_commit() const;
+};
+
+// Function Prototypes
+unsigned int crc32_update(unsigned int crc, const void *data, size_t len);
+DURABLE_STATE durable_verify(const char *path, const char *index_path);
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <stdio.h>
+#include <string.h>
+
+#include <iomanip>
+
+#include "frame.h"
+#include "logger.h"
+
+using namespace std;
+
+// Type Definitions
+/* Two lowercase hex digits for every byte value. */
+struct HexDigitTable {
+  char pairs[256][2];
+
+  constexpr HexDigitTable() : pairs()
+  {
+    const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 256; i++) {
+      pairs[i][0] = digits[i >> 4];
+      pairs[i][1] = digits[i & 0xf];
+    }
+  }
+};
+
+// Global Variables
+static constexpr HexDigitTable hex_digits;
+
+
+// Function Prototypes
+static inline char *put_hex_unpadded(char *out, unsigned char value);
+
+
+
+// Function Definitions
+int generate_checksum(const unsigned char *data, int data_len)
+{
+  int i, checksum;
+
+  checksum = 0;
+  for (i = 0; i < data_len; i++) {
+    checksum += data[i];
+  }
+
+  return checksum & 0xff;
+}
+
+
+
+int frame_is_complete(const unsigned char *frame, int frame_len)
+{
+  if (frame_len > 0) {
+    if (frame[0] != 0xaa) {
+      /* Need to sync on 0xaa at start of frames, so just skip. */
+      return 1;
+    }
+  }
+
+  if (frame_len < 2) {
+    return 0;
+  }
+
+  if (frame[1] == 0x55) { /* Command frame... */
+    if (frame_len >= 20) { /* ...always 20 bytes. */
+      return 1;
+    } else {
+      return 0;
+    }
+  } else if ((frame[1] >> 4) == 0xc) { /* Data frame... */
+    if (frame_len >= (frame[1] & 0xf) + 5) { /* ...payload and 5 bytes. */
+      return 1;
+    } else {
+      return 0;
+    }
+  }
+
+  /* Unhandled frame type. */
+  return 1;
+}
+
+
+
+int hex_value(int c)
+{
+  if (c >= 0x30 && c <= 0x39) /* '0' - '9' */
+    return c - 0x30;
+  else if (c >= 0x41 && c <= 0x46) /* 'A' - 'F' */
+    return (c - 0x41) + 10;
+  else if (c >= 0x61 && c <= 0x66) /* 'a' - 'f' */
+    return (c - 0x61) + 10;
+  else
+    return -1;
+}
+
+
+
+int convert_from_hex(const char *hex_string, unsigned char *bin_string, int bin_string_len)
+{
+  int n1, n2, high;
+
+  high = -1;
+  n1 = n2 = 0;
+  while (hex_string[n1] != '\0') {
+    if (hex_value(hex_string[n1]) >= 0) {
+      if (high == -1) {
+        high = hex_string[n1];
+      } else {
+        bin_string[n2] = hex_value(high) * 16 + hex_value(hex_string[n1]);
+        n2++;
+        if (n2 >= bin_string_len) {
+          printf("hex string truncated to %d bytes\n", n2);
+          break;
+        }
+        high = -1;
+      }
+    }
+    n1++;
+  }
+
+  return n2;
+}
+
+
+
+void print_frame(unsigned char *frame)
+{
+  int i;
+  int frame_len = sizeof(frame);
+  char temp_string[4095];
+  if ((frame_len >= 6) && (frame[0] == 0xaa) && ((frame[1] >> 4) == 0xc)) {
+    printf("Frame ID: %02x%02x, Data: ", frame[3], frame[2]);
+    sprintf(debug_output, "Frame ID: %02x%02x, Data: ", frame[3], frame[2]);
+    logger.log(debug_output, INFO);
+    sprintf(debug_output, " ");
+    for (i = 4; i < 12; i++) {
+      printf("%02x ", frame[i]);
+      sprintf(temp_string, "%02x ", frame[i]);
+      strcat(debug_output, temp_string);
+    }
+    printf("\n");
+    logger.log(debug_output, INFO);
+  } else {
+    printf("Unknown: ");
+    sprintf(debug_output, "Unknown: ");
+    for (i = 0; i <= frame_len; i++) {
+      printf("%02x ", frame[i]);
+      sprintf(temp_string, "%02x ", frame[i]);
+      strcat(debug_output, temp_string);
+    }
+    printf("\n");
+    logger.log(debug_output, INFO);
+  }
+}
+
+
+
+bool is_data_frame(const unsigned char *frame, int frame_len)
+{
+  return (frame_len >= 6) && (frame[0] == 0xaa) && ((frame[1] >> 4) == 0xc);
+}
+
+
+
+/* Console echo of a dump frame. Like the file layout below, data frames always
+ * show 8 data bytes and unknown frames show one byte past frame_len, so frame
+ * must point at a CANUSB_FRAME_BUFFER_SIZE buffer. */
+void print_dump_frame(const unsigned char *frame, int frame_len)
+{
+  if (is_data_frame(frame, frame_len)) {
+    printf("Frame ID: %02x%02x, Data: ", frame[3], frame[2]);
+    for (int j = 4; j < 12; j++) {
+      printf("%02x ", (int)frame[j]);
+    }
+    printf("\n");
+  } else {
+    printf("Unknown: ");
+    for (int j = 0; j <= frame_len; j++) {
+      printf("%02x ", frame[j]);
+    }
+    printf("\n");
+  }
+}
+
+
+
+/* Text dump layout as read by the downstream scripts: the ID and unknown bytes
+ * are written unpadded and each data line is terminated by a NUL (ends).
+ * format_dump_frame() is the fast path and must stay byte-identical to this. */
+void write_dump_frame(ostream& dump_file, const unsigned char *frame, int frame_len)
+{
+  if (is_data_frame(frame, frame_len)) {
+    dump_file << "Frame ID: " << hex << (int)frame[3] << (int)frame[2] << dec << ", Data: ";
+    for (int j = 4; j < 12; j++) {
+      dump_file << hex << setw(2) << setfill('0') << (int)frame[j] << dec << " ";
+    }
+    dump_file << "\n" << ends;
+  } else {
+    dump_file << "Unknown: ";
+    for (int j = 0; j <= frame_len; j++) {
+      dump_file << hex << (int)frame[j] << dec << " ";
+    }
+    dump_file << "\n";
+  }
+}
+
+
+
+/* Formats one frame of the write_dump_frame() layout into line, which must
+ * hold DUMP_LINE_SIZE bytes, and returns its length including the NUL of a
+ * data line. frame must point at a CANUSB_FRAME_BUFFER_SIZE buffer. */
+int format_dump_frame(char *line, const unsigned char *frame, int frame_len)
+{
+  char *out = line;
+
+  if (is_data_frame(frame, frame_len)) {
+    memcpy(out, "Frame ID: ", 10);
+    out = put_hex_unpadded(out + 10, frame[3]);
+    out = put_hex_unpadded(out, frame[2]);
+    memcpy(out, ", Data: ", 8);
+    out += 8;
+    for (int j = 4; j < 12; j++) {
+      out[0] = hex_digits.pairs[frame[j]][0];
+      out[1] = hex_digits.pairs[frame[j]][1];
+      out[2] = ' ';
+      out += 3;
+    }
+    *out++ = '\n';
+    *out++ = '\0';
+  } else {
+    memcpy(out, "Unknown: ", 9);
+    out += 9;
+    for (int j = 0; j <= frame_len; j++) {
+      out = put_hex_unpadded(out, frame[j]);
+      *out++ = ' ';
+    }
+    *out++ = '\n';
+  }
+
+  return out - line;
+}
+
+
+
+/* What `<< hex << (int)value` writes: no leading zero. */
+static inline char *put_hex_unpadded(char *out, unsigned char value)
+{
+  if (value >= 0x10) {
+    *out++ = hex_digits.pairs[value][0];
+  }
+  *out++ = hex_digits.pairs[value][1];
+  return out;
+}
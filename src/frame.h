@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_FRAME_H
+#define RADMON_FRAME_H
+
+// Includes
+#include <ostream>
+
+// Constants
+#define CANUSB_FRAME_BUFFER_SIZE 32 /* bytes, every frame buffer handed to the kernels below */
+#define DUMP_LINE_SIZE 128         /* bytes, longest line format_dump_frame() writes */
+
+// Function Prototypes
+int generate_checksum(const unsigned char *data, int data_len);
+int frame_is_complete(const unsigned char *frame, int frame_len);
+int hex_value(int c);
+int convert_from_hex(const char *hex_string, unsigned char *bin_string, int bin_string_len);
+void print_frame(unsigned char *frame);
+bool is_data_frame(const unsigned char *frame, int frame_len);
+void print_dump_frame(const unsigned char *frame, int frame_len);
+void write_dump_frame(std::ostream& dump_file, const unsigned char *frame, int frame_len);
+int format_dump_frame(char *line, const unsigned char *frame, int frame_len);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include <algorithm>
+
+#include "frame.h"
+#include "frame_publisher.h"
+#include "logger.h"
+#include "tracer.h"
+
+using namespace std;
+
+
+
+// Function Definitions
+int FramePublisher::start(const char *socket_path)
+{
+  struct sockaddr_un address = {};
+
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    sprintf(debug_output, "Publish socket path too long: %s", socket_path);
+    logger.log(debug_output, ERROR);
+    return -1;
+  }
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+
+  listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd == -1) {
+    sprintf(debug_output, "socket() failed: %s", strerror(errno));
+    logger.log(debug_output, ERROR);
+    return -1;
+  }
+  unlink(socket_path);
+  if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(listen_fd, SOMAXCONN) == -1) {
+    snprintf(debug_output, sizeof(debug_output), "Unable to listen on %s: %s", socket_path, strerror(errno));
+    logger.log(debug_output, ERROR);
+    close(listen_fd);
+    listen_fd = -1;
+    return -1;
+  }
+
+  this->socket_path = socket_path;
+  running.store(true, memory_order_relaxed);
+  sender = thread(&FramePublisher::run, this);
+  snprintf(debug_output, sizeof(debug_output), "Publishing frames on %s", socket_path);
+  logger.log(debug_output, INFO);
+  return 0;
+}
+
+
+
+void FramePublisher::stop()
+{
+  if (!sender.joinable()) {
+    return;
+  }
+  running.store(false, memory_order_relaxed);
+  sender.join();
+
+  long overflows = ring_overflows.load(memory_order_relaxed);
+  sprintf(debug_output, "Stopped publishing frames on %s, %ld records lost to a full ring",
+          socket_path.c_str(), overflows);
+  logger.log(debug_output, overflows > 0 ? WARN : INFO);
+
+  for (Subscriber& subscriber : subscribers) {
+    close(subscriber.fd);
+  }
+  subscribers.clear();
+  close(listen_fd);
+  listen_fd = -1;
+  unlink(socket_path.c_str());
+}
+
+
+
+FramePublisher::~FramePublisher()
+{
+  stop();
+}
+
+
+
+/* Called on the serial intake path for every parsed frame: one clock read
+ * and a copy into the ring. A full ring drops the record rather than wait. */
+void FramePublisher::publish(const unsigned char *frame, int frame_len)
+{
+  uint32_t head = ring_head.load(memory_order_relaxed);
+  uint32_t seq = next_seq++;
+  struct timespec now;
+
+  if (head - ring_tail.load(memory_order_acquire) >= PUBLISH_RING_RECORDS) {
+    ring_overflows.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+
+  PublishedFrame& record = ring[head & (PUBLISH_RING_RECORDS - 1)];
+  clock_gettime(CLOCK_REALTIME, &now);
+  record.timestamp_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+  record.seq = seq;
+  if (is_data_frame(frame, frame_len)) {
+    record.can_id = frame[2] | (frame[3] << 8);
+    record.flags = PUBLISH_FLAG_DATA;
+    record.len = min(frame[1] & 0x0f, (int)sizeof(record.data));
+    memcpy(record.data, &frame[4], sizeof(record.data));
+  } else {
+    record.can_id = 0;
+    record.flags = 0;
+    record.len = min(frame_len, (int)sizeof(record.data));
+    memset(record.data, 0, sizeof(record.data));
+    memcpy(record.data, frame, record.len);
+  }
+  ring_head.store(head + 1, memory_order_release);
+}
+
+
+
+void FramePublisher::run()
+{
+  struct pollfd pfd = {};
+  pfd.fd = listen_fd;
+  pfd.events = POLLIN;
+  trace_thread_name("publisher");
+
+  while (running.load(memory_order_relaxed)) {
+    uint32_t tail = ring_tail.load(memory_order_relaxed);
+    uint32_t available = ring_head.load(memory_order_acquire) - tail;
+
+    if (available == 0) {
+      if (poll(&pfd, 1, PUBLISH_POLL_MS) > 0) {
+        accept_subscribers();
+      }
+      continue;
+    }
+
+    accept_subscribers();
+
+    /* A batch never wraps the ring, so it goes out as one contiguous block. */
+    uint32_t start = tail & (PUBLISH_RING_RECORDS - 1);
+    uint32_t count = min({ available, (uint32_t)PUBLISH_BATCH_RECORDS, PUBLISH_RING_RECORDS - start });
+    TraceSpan span("publish batch", "publish");
+    span.arg = count;
+    send_batch(&ring[start], count);
+    ring_tail.store(tail + count, memory_order_release);
+  }
+}
+
+
+
+void FramePublisher::accept_subscribers()
+{
+  int fd;
+  char message[128];
+
+  while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+    subscribers.push_back({ fd, 0, 0 });
+    snprintf(message, sizeof(message), "Frame subscriber connected (%zu total)", subscribers.size());
+    logger.log(message, INFO);
+  }
+}
+
+
+
+/* A subscriber whose socket is full skips this batch and is told how many
+ * records it missed in the header of the next one it does receive. */
+void FramePublisher::send_batch(const PublishedFrame *records, uint32_t count)
+{
+  for (size_t k = 0; k < subscribers.size();) {
+    Subscriber& subscriber = subscribers[k];
+    PublishedBatch header = { count, subscriber.missed };
+    struct iovec iov[2] = {
+      { &header, sizeof(header) },
+      { (void *)records, count * sizeof(PublishedFrame) },
+    };
+    struct msghdr message = {};
+    message.msg_iov = iov;
+    message.msg_iovlen = 2;
+
+    if (sendmsg(subscriber.fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL) != -1) {
+      subscriber.missed = 0;
+      subscriber.missed_in_row = 0;
+      k++;
+      continue;
+    }
+
+    if (errno == EAGAIN) {
+      subscriber.missed += count;
+      subscriber.missed_in_row += count;
+      if (subscriber.missed_in_row < PUBLISH_DROP_AFTER) {
+        k++;
+        continue;
+      }
+      logger.log("Frame subscriber too slow, disconnected", WARN);
+    } else if (errno != EPIPE && errno != ECONNRESET) {
+      char message[128];
+      snprintf(message, sizeof(message), "Frame subscriber send failed: %s", strerror(errno));
+      logger.log(message, WARN);
+    }
+    close(subscriber.fd);
+    subscribers.erase(subscribers.begin() + k);
+  }
+}
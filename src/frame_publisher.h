@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_FRAME_PUBLISHER_H
+#define RADMON_FRAME_PUBLISHER_H
+
+// Includes
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Constants
+#define PUBLISH_RING_RECORDS 16384   /* power of two */
+#define PUBLISH_BATCH_RECORDS 256    /* records per message at most */
+#define PUBLISH_POLL_MS 5            /* how long the sender sleeps with nothing to send */
+#define PUBLISH_DROP_AFTER 65536     /* consecutive missed records before a subscriber is cut off */
+
+#define PUBLISH_FLAG_DATA    0x01    /* standard data frame; otherwise the first raw bytes */
+
+// Type Definitions
+/* Wire format, host byte order. Each SOCK_SEQPACKET message is one
+ * PublishedBatch header followed by count PublishedFrame records. */
+struct PublishedBatch {
+  uint32_t count;
+  uint32_t missed;       /* records this subscriber lost since its last message */
+};
+
+struct PublishedFrame {
+  uint64_t timestamp_ns; /* CLOCK_REALTIME when the frame was parsed */
+  uint32_t seq;          /* gaps mean records were missed */
+  uint16_t can_id;
+  uint8_t flags;
+  uint8_t len;
+  uint8_t data[8];
+};
+
+static_assert(sizeof(PublishedBatch) == 8);
+static_assert(sizeof(PublishedFrame) == 24);
+
+/* Fans parsed frames out to any number of local subscribers on a UNIX
+ * socket. publish() only copies into a lock-free ring read by the sender
+ * thread, so a slow or stuck subscriber can never stall serial intake: its
+ * unsent records are counted as missed, and it is disconnected after
+ * PUBLISH_DROP_AFTER of them in a row. publish() must be called from a single
+ * thread. */
+class FramePublisher {
+  public:
+    std::atomic<long> ring_overflows{0}; /* records lost before reaching any subscriber */
+
+    int start(const char *socket_path);
+    void stop();
+    void publish(const unsigned char *frame, int frame_len);
+    ~FramePublisher();
+
+  private:
+    struct Subscriber {
+      int fd;
+      uint32_t missed;
+      long missed_in_row;
+    };
+
+    std::string socket_path;
+    int listen_fd = -1;
+    std::vector<Subscriber> subscribers; /* sender thread only */
+    PublishedFrame ring[PUBLISH_RING_RECORDS];
+    std::atomic<uint32_t> ring_head{0};  /* next record to write */
+    std::atomic<uint32_t> ring_tail{0};  /* next record to send */
+    uint32_t next_seq = 0;
+    std::atomic<bool> running{false};
+    std::thread sender;
+
+    void run();
+    void accept_subscribers();
+    void send_batch(const PublishedFrame *records, uint32_t count);
+};
+
+#endif
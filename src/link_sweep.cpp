@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "link_sweep.h"
+#include "logger.h"
+#include "selftest.h"
+#include "tracer.h"
+
+using namespace std;
+
+
+
+// Function Prototypes
+static int parse_int_list(const string& text, const char *default_list, vector<int>& values);
+
+
+
+// Function Definitions
+bool SweepResult::is_loss_free() const
+{
+  return is_configured && frames > 0 && lost == 0 && errors == 0;
+}
+
+
+
+/* Parses "SPEEDS:BAUDRATES[:WORKLOAD]", each list comma separated. An empty
+ * list sweeps the defaults, so ":" alone is a full loopback sweep. WORKLOAD
+ * is loopback or dump. */
+int parse_sweep_spec(const char *arg, SweepSpec& spec)
+{
+  string text(arg);
+  size_t bauds_start = text.find(':');
+  size_t workload_start = bauds_start == string::npos ? string::npos : text.find(':', bauds_start + 1);
+
+  spec = SweepSpec();
+  if (bauds_start == string::npos) {
+    return -1;
+  }
+  if (parse_int_list(text.substr(0, bauds_start), SWEEP_SPEEDS_DEFAULT, spec.speeds) == -1
+      || parse_int_list(text.substr(bauds_start + 1, workload_start == string::npos ? string::npos
+                                                     : workload_start - bauds_start - 1),
+                        SWEEP_BAUDRATES_DEFAULT, spec.baudrates) == -1) {
+    return -1;
+  }
+  for (int speed : spec.speeds) {
+    if (canusb_int_to_speed(speed) == 0) {
+      return -1;
+    }
+  }
+
+  if (workload_start != string::npos) {
+    string workload = text.substr(workload_start + 1);
+    if (workload == "dump") {
+      spec.workload = SWEEP_WORKLOAD_DUMP;
+    } else if (workload != "loopback") {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+
+/* Moves the adapter through every combination, fastest CAN speed first, and
+ * runs the workload on each. The link's own settings are restored at the
+ * end, whatever the sweep found. */
+int run_link_sweep(AdapterLink& link, const SweepSpec& spec, const SweepWorkload& workload, SweepReport& report)
+{
+  int baudrate = link.baudrate;
+  CANUSB_SPEED speed = link.speed;
+
+  report = {};
+  report.best = -1;
+  for (int can_speed : spec.speeds) {
+    for (int tty_baudrate : spec.baudrates) {
+      SweepResult result = {};
+      result.speed = can_speed;
+      result.baudrate = tty_baudrate;
+
+      link.speed = canusb_int_to_speed(can_speed);
+      link.baudrate = tty_baudrate;
+      fprintf(stderr, "Sweep: %d bps CAN, %d baud serial.\n", can_speed, tty_baudrate);
+      result.is_configured = link.reopen() == 0;
+      if (result.is_configured) {
+        traced_usleep(SWEEP_SETTLE_MS * 1000);
+        clear_buffer(link.tty_fd);
+        result.is_configured = workload(result) == 0;
+      }
+      report.results.push_back(result);
+
+      sprintf(debug_output, "Sweep %d bps, %d baud: %s %.0f frames/s, %d frames, lost %d, errors %d, latency %.0f us",
+              can_speed, tty_baudrate, result.is_configured ? "" : "not configured,", result.throughput,
+              result.frames, result.lost, result.errors, result.latency_us);
+      logger.log(debug_output, result.is_loss_free() ? INFO : WARN);
+    }
+  }
+
+  for (int i = 0; i < (int)report.results.size(); i++) {
+    const SweepResult& result = report.results[i];
+    if (!result.is_loss_free()) {
+      continue;
+    }
+    if (report.best == -1) {
+      report.best = i;
+      continue;
+    }
+    const SweepResult& best = report.results[report.best];
+    if (result.throughput > best.throughput * (1 + SWEEP_TIE_FRACTION)
+        || (result.throughput >= best.throughput * (1 - SWEEP_TIE_FRACTION) && result.latency_us < best.latency_us)) {
+      report.best = i;
+    }
+  }
+
+  link.baudrate = baudrate;
+  link.speed = speed;
+  link.mode = CANUSB_MODE_NORMAL;
+  return link.reopen();
+}
+
+
+
+/* Steps the loopback rate up as run_loopback_selftest() does, ending with
+ * what the slower of the bus and the serial link can carry, and stops at the
+ * first step that loses a frame. The result is the highest loss-free step,
+ * or the first step if even that one lost frames. The adapter must already
+ * be in a loopback mode. */
+int sweep_loopback(int tty_fd, SweepResult& result)
+{
+  double bus_rate = (double)result.speed / SWEEP_BUS_FRAME_BITS;
+  double serial_rate = (double)result.baudrate / (SWEEP_SERIAL_BITS_PER_BYTE * SWEEP_SERIAL_FRAME_BYTES);
+  int link_rate = max(min((int)min(bus_rate, serial_rate), SELFTEST_MAX_RATE), 1);
+  unsigned int seq_base = 0;
+  bool is_first_step = true;
+
+  for (double rate = SELFTEST_START_RATE; ; rate *= SELFTEST_RATE_STEP) {
+    int step_rate = min((int)rate, link_rate);
+    SelfTestStep step;
+    if (run_loopback_step(tty_fd, step_rate, SWEEP_STEP_MS, seq_base, step) < 0) {
+      return is_first_step ? -1 : 0;
+    }
+    seq_base += step.sent + step.send_errors;
+
+    bool is_loss_free = !step.lost && !step.corrupt && !step.send_errors;
+    if (is_loss_free || is_first_step) {
+      result.frames = step.received;
+      result.throughput = step.received * 1000.0 / SWEEP_STEP_MS;
+      result.lost = step.lost;
+      result.errors = step.corrupt + step.send_errors;
+      result.latency_us = step.latency_p50_us;
+      result.latency_worst_us = step.latency_p99_us;
+    }
+    is_first_step = false;
+    if (!is_loss_free || step_rate == link_rate) {
+      return 0;
+    }
+  }
+}
+
+
+
+void print_sweep_report(const SweepReport& report)
+{
+  printf("%8s %8s %9s %7s %5s %6s %9s %9s\n",
+         "speed", "baud", "frames/s", "frames", "lost", "errors", "p50 us", "worst us");
+  for (int i = 0; i < (int)report.results.size(); i++) {
+    const SweepResult& result = report.results[i];
+    if (!result.is_configured) {
+      printf("%8d %8d  (could not be configured)\n", result.speed, result.baudrate);
+      continue;
+    }
+    printf("%8d %8d %9.0f %7d %5d %6d %9.0f %9.0f%s\n",
+           result.speed, result.baudrate, result.throughput, result.frames, result.lost, result.errors,
+           result.latency_us, result.latency_worst_us, i == report.best ? "  *" : "");
+  }
+
+  if (report.best == -1) {
+    printf("No combination was loss-free.\n");
+  } else {
+    const SweepResult& best = report.results[report.best];
+    printf("Fastest loss-free: -s %d -b %d (%.0f frames/s, latency p50 %.0f us)\n",
+           best.speed, best.baudrate, best.throughput, best.latency_us);
+  }
+}
+
+
+
+/* Comma separated integers; an empty string takes default_list. */
+static int parse_int_list(const string& text, const char *default_list, vector<int>& values)
+{
+  string list = text.empty() ? string(default_list) : text;
+  size_t start = 0;
+
+  while (start <= list.size()) {
+    size_t comma = list.find(',', start);
+    string item = list.substr(start, comma == string::npos ? string::npos : comma - start);
+    char *end;
+    long value = strtol(item.c_str(), &end, 10);
+    if (item.empty() || *end != '\0' || value <= 0) {
+      return -1;
+    }
+    values.push_back(value);
+    if (comma == string::npos) {
+      break;
+    }
+    start = comma + 1;
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_LINK_SWEEP_H
+#define RADMON_LINK_SWEEP_H
+
+// Includes
+#include <functional>
+#include <vector>
+
+#include "canusb.h"
+
+// Constants
+#define SWEEP_SPEEDS_DEFAULT "1000000,800000,500000,250000,125000"
+#define SWEEP_BAUDRATES_DEFAULT "115200,230400,460800,921600,1000000,2000000"
+#define SWEEP_STEP_MS 1000           /* loopback burst per rate step */
+#define SWEEP_SETTLE_MS 100          /* after reconfiguring, before the workload */
+#define SWEEP_TIE_FRACTION 0.02      /* throughputs this close are ranked by latency */
+#define SWEEP_SERIAL_BITS_PER_BYTE 11 /* start, 8 data, 2 stop */
+#define SWEEP_SERIAL_FRAME_BYTES 13  /* an 8-byte data frame on the serial link */
+#define SWEEP_BUS_FRAME_BITS 130     /* an 8-byte standard data frame with typical stuffing */
+
+// Type Definitions
+typedef enum {
+  SWEEP_WORKLOAD_LOOPBACK,
+  SWEEP_WORKLOAD_DUMP,
+} SWEEP_WORKLOAD;
+
+struct SweepSpec {
+  std::vector<int> speeds;     /* CAN bps */
+  std::vector<int> baudrates;  /* serial */
+  SWEEP_WORKLOAD workload = SWEEP_WORKLOAD_LOOPBACK;
+};
+
+/* One speed and baudrate combination. Latency is send to echo for the
+ * loopback workload and the round trip of a part dump probe for dumps. */
+struct SweepResult {
+  int speed;
+  int baudrate;
+  bool is_configured;      /* the tty and adapter took the settings */
+  double throughput;       /* frames/s delivered, at the highest loss-free loopback rate */
+  int frames;              /* delivered */
+  int lost;
+  int errors;              /* corrupt or damaged frames, failed writes, serial errors */
+  double latency_us;       /* median */
+  double latency_worst_us; /* p99 for loopback, slowest probe for dumps */
+
+  bool is_loss_free() const;
+};
+
+struct SweepReport {
+  std::vector<SweepResult> results;
+  int best; /* index into results, -1 if no combination was loss-free */
+};
+
+typedef std::function<int(SweepResult& result)> SweepWorkload;
+
+// Function Prototypes
+int parse_sweep_spec(const char *arg, SweepSpec& spec);
+int run_link_sweep(AdapterLink& link, const SweepSpec& spec, const SweepWorkload& workload, SweepReport& report);
+int sweep_loopback(int tty_fd, SweepResult& result);
+void print_sweep_report(const SweepReport& report);
+
+#endif
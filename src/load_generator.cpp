@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#include <string>
+
+#include "frame.h"
+#include "load_generator.h"
+#include "logger.h"
+#include "realtime.h"
+#include "tracer.h"
+
+using namespace std;
+
+
+
+// Function Definitions
+void LoadGenerator::start(int tty_fd, const LoadSpec& spec)
+{
+  stop();
+  this->tty_fd = tty_fd;
+  this->spec = spec;
+  if (this->spec.ids.empty()) {
+    this->spec.ids.push_back(LOAD_ID_DEFAULT);
+  }
+  frames_sent.store(0, memory_order_relaxed);
+  send_errors.store(0, memory_order_relaxed);
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  running.store(true, memory_order_relaxed);
+  injector = thread(&LoadGenerator::run, this);
+}
+
+
+
+void LoadGenerator::stop()
+{
+  if (!injector.joinable()) {
+    return;
+  }
+  running.store(false, memory_order_relaxed);
+  injector.join();
+  clock_gettime(CLOCK_MONOTONIC, &stop_time);
+}
+
+
+
+double LoadGenerator::elapsed() const
+{
+  struct timespec end = stop_time;
+  if (injector.joinable()) {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+  }
+  return (end.tv_sec - start_time.tv_sec) + (end.tv_nsec - start_time.tv_nsec) / 1e9;
+}
+
+
+
+double LoadGenerator::achieved_rate() const
+{
+  double seconds = elapsed();
+  return seconds > 0 ? frames_sent.load(memory_order_relaxed) / seconds : 0;
+}
+
+
+
+LoadGenerator::~LoadGenerator()
+{
+  stop();
+}
+
+
+
+/* Sends on an absolute schedule, so a late wakeup is caught up on rather
+ * than lowering the rate. */
+void LoadGenerator::run()
+{
+  long period_ns = spec.rate > 0 ? 1000000000L / spec.rate : CANUSB_INJECT_SLEEP_GAP_DEFAULT * 1000000L;
+  unsigned long long counter = 0;
+  unsigned long long random_state = start_time.tv_nsec | 1;
+  unsigned char data[LOAD_DATA_LEN];
+  int data_len = LOAD_DATA_LEN;
+  struct timespec send_at = start_time;
+  size_t next_id = 0;
+
+  release_thread_realtime();
+  trace_thread_name("load generator");
+  if (spec.mode == CANUSB_INJECT_PAYLOAD_MODE_FIXED) {
+    memcpy(data, spec.fixed_data, spec.fixed_len);
+    data_len = spec.fixed_len;
+  }
+
+  while (running.load(memory_order_relaxed)) {
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &send_at, NULL) == EINTR) {
+    }
+
+    if (spec.mode == CANUSB_INJECT_PAYLOAD_MODE_RANDOM) {
+      random_state ^= random_state << 13;
+      random_state ^= random_state >> 7;
+      random_state ^= random_state << 17;
+      memcpy(data, &random_state, LOAD_DATA_LEN);
+    } else if (spec.mode == CANUSB_INJECT_PAYLOAD_MODE_INCREMENTAL) {
+      for (int i = 0; i < LOAD_DATA_LEN; i++) {
+        data[i] = counter >> (8 * (LOAD_DATA_LEN - 1 - i));
+      }
+      counter++;
+    }
+
+    CanusbDataFrame frame = encode_data_frame(spec.ids[next_id], data, data_len);
+    next_id = (next_id + 1) % spec.ids.size();
+    if (frame_send(tty_fd, frame.bytes, frame.len) < 0) {
+      send_errors.fetch_add(1, memory_order_relaxed);
+    } else {
+      frames_sent.fetch_add(1, memory_order_relaxed);
+    }
+
+    send_at.tv_nsec += period_ns;
+    while (send_at.tv_nsec >= 1000000000L) {
+      send_at.tv_nsec -= 1000000000L;
+      send_at.tv_sec++;
+    }
+  }
+}
+
+
+
+/* RATE[:MODE[:ID[,ID...]]] where MODE is "random", "incremental" or up to
+ * eight hex bytes sent as a fixed payload, e.g. 2000:incremental:100,101. */
+int parse_load_spec(const char *arg, LoadSpec& spec)
+{
+  string text(arg);
+  size_t mode_start = text.find(':');
+  size_t ids_start = mode_start == string::npos ? string::npos : text.find(':', mode_start + 1);
+  char *end;
+
+  spec = LoadSpec();
+  spec.rate = strtol(text.substr(0, mode_start).c_str(), &end, 10);
+  if (*end != '\0' || spec.rate < 0) {
+    return -1;
+  }
+  if (mode_start == string::npos) {
+    return 0;
+  }
+
+  string mode = text.substr(mode_start + 1, ids_start == string::npos ? string::npos : ids_start - mode_start - 1);
+  if (mode == "random") {
+    spec.mode = CANUSB_INJECT_PAYLOAD_MODE_RANDOM;
+  } else if (mode == "incremental") {
+    spec.mode = CANUSB_INJECT_PAYLOAD_MODE_INCREMENTAL;
+  } else {
+    /* The length is checked first: convert_from_hex() warns as soon as its
+     * buffer is full, even when the string ends there. */
+    unsigned char fixed_data[LOAD_DATA_LEN + 1];
+    spec.mode = CANUSB_INJECT_PAYLOAD_MODE_FIXED;
+    if (mode.empty() || mode.size() % 2 != 0 || mode.size() > LOAD_DATA_LEN * 2) {
+      return -1;
+    }
+    spec.fixed_len = convert_from_hex(mode.c_str(), fixed_data, sizeof(fixed_data));
+    if ((int)mode.size() != spec.fixed_len * 2) {
+      return -1;
+    }
+    memcpy(spec.fixed_data, fixed_data, spec.fixed_len);
+  }
+  if (ids_start == string::npos) {
+    return 0;
+  }
+
+  string ids = text.substr(ids_start + 1);
+  size_t start = 0;
+  while (start <= ids.size()) {
+    size_t comma = ids.find(',', start);
+    unsigned short id;
+    if (parse_can_id(ids.substr(start, comma - start).c_str(), &id) == -1) {
+      return -1;
+    }
+    spec.ids.push_back(id);
+    if (comma == string::npos) {
+      break;
+    }
+    start = comma + 1;
+  }
+  return 0;
+}
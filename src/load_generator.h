@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_LOAD_GENERATOR_H
+#define RADMON_LOAD_GENERATOR_H
+
+// Includes
+#include <time.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "canusb.h"
+
+// Constants
+#define LOAD_ID_DEFAULT 0x7f0
+#define LOAD_DATA_LEN 8
+
+// Type Definitions
+/* Rate 0 falls back to one frame per CANUSB_INJECT_SLEEP_GAP_DEFAULT. IDs are
+ * used round-robin. */
+struct LoadSpec {
+  int rate = 0; /* frames/s */
+  CANUSB_PAYLOAD_MODE mode = CANUSB_INJECT_PAYLOAD_MODE_RANDOM;
+  unsigned char fixed_data[LOAD_DATA_LEN] = {};
+  int fixed_len = 0;
+  std::vector<unsigned short> ids;
+};
+
+/* Injects frames from its own thread while the caller runs a dump. Sends go
+ * through frame_send, which serialises them with the dump's commands. */
+class LoadGenerator {
+  public:
+    std::atomic<long> frames_sent{0};
+    std::atomic<long> send_errors{0};
+
+    void start(int tty_fd, const LoadSpec& spec);
+    void stop();
+    double elapsed() const;
+    double achieved_rate() const;
+    ~LoadGenerator();
+
+  private:
+    int tty_fd = -1;
+    LoadSpec spec;
+    std::atomic<bool> running{false};
+    std::thread injector;
+    struct timespec start_time = {};
+    struct timespec stop_time = {};
+
+    void run();
+};
+
+// Function Prototypes
+int parse_load_spec(const char *arg, LoadSpec& spec);
+
+#endif
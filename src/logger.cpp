@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <stdio.h>
+#include <time.h>
+
+#include "logger.h"
+
+using namespace std;
+
+// Global Variables
+char debug_output[4095];
+LoggerClass logger;
+
+
+
+// Function Definitions
+void LoggerClass::set_log_path(char* log_path)
+{
+  lock_guard<mutex> lock(log_mutex);
+  log_writer.close();
+  if (log_writer.open_append(log_path) == -1) {
+    fprintf(stderr, "Unable to open log file %s\n", log_path);
+  }
+}
+
+
+
+void LoggerClass::log(string string, LOGGING_LEVEL log_level)
+{
+  lock_guard<mutex> lock(log_mutex);
+  if (!log_writer.is_open()) {
+    fprintf(stderr, "Log file not open!\n");
+    return;
+  }
+  char time_string[50];
+  time_t ts = time(NULL);
+  struct tm datetime;
+  localtime_r(&ts, &datetime);
+  strftime(time_string, 50, "%F %H:%M:%S ", &datetime);
+  std::string print_string(time_string);
+  switch(log_level) {
+  case 0:
+    print_string.append("\033[1;37m[INFO] ");
+    break;
+  
+  case 1:
+    print_string.append("\033[1;33m[WARN] ");
+    break;
+
+  case 2:
+    print_string.append("\033[1;31m[ERROR] ");
+    break;
+  }
+
+  print_string.append(string).append("\033[0m\n");
+  log_writer.write_record(print_string);
+  /* The group commit only runs when a later line arrives, which may be
+   * never; warnings and errors are the lines worth waiting for. */
+  if (log_level != INFO) {
+    log_writer.commit();
+  }
+}
+
+
+
+LoggerClass::~LoggerClass()
+{
+  log_writer.close();
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_LOGGER_H
+#define RADMON_LOGGER_H
+
+// Includes
+#include <mutex>
+#include <string>
+
+#include "durable_writer.h"
+
+// Type Definitions
+typedef enum {
+  INFO    = 0,
+  WARN    = 1,
+  ERROR   = 2,
+} LOGGING_LEVEL;
+
+/* log() may be called from any thread; messages must not be formatted in
+ * debug_output off the main thread. WARN and ERROR lines are committed to
+ * disk before log() returns, INFO lines with the next group commit. */
+class LoggerClass {
+  public:
+    DurableWriter log_writer;
+    void set_log_path(char* log_path);
+    void log(std::string string, LOGGING_LEVEL log_level);
+    ~LoggerClass();
+
+  private:
+    std::mutex log_mutex; /* guards log_writer */
+};
+
+// Global Variables
+extern char debug_output[4095];
+extern LoggerClass logger;
+
+#endif
@@ -35,131 +35,40 @@
 #include <fstream>
 #include <linux/limits.h>
 #include <iomanip>
+#include <utility>
+#include <vector>
+
+#include "canusb.h"
+#include "frame_publisher.h"
+#include "link_sweep.h"
+#include "load_generator.h"
+#include "logger.h"
+#include "radmon.h"
+#include "radmon_group.h"
+#include "realtime.h"
+#include "selftest.h"
+#include "tracer.h"
+#include "upset_monitor.h"
 
 using namespace std;
 
-// Constants
-#define CANUSB_INJECT_SLEEP_GAP_DEFAULT 200 /* ms */
-#define CANUSB_CAN_SPEED_DEFAULT 500000
-#define CANUSB_TTY_BAUD_RATE_DEFAULT 2000000
-#define CANUSB_INJECT_ID_DEFAULT "010"
-#define CANUSB_RECEIVE_ID_DEFAULT "011"
-
-// Type Definitions
-typedef enum {
-  CANUSB_SPEED_1000000 = 0x01,
-  CANUSB_SPEED_800000  = 0x02,
-  CANUSB_SPEED_500000  = 0x03,
-  CANUSB_SPEED_400000  = 0x04,
-  CANUSB_SPEED_250000  = 0x05,
-  CANUSB_SPEED_200000  = 0x06,
-  CANUSB_SPEED_125000  = 0x07,
-  CANUSB_SPEED_100000  = 0x08,
-  CANUSB_SPEED_50000   = 0x09,
-  CANUSB_SPEED_20000   = 0x0a,
-  CANUSB_SPEED_10000   = 0x0b,
-  CANUSB_SPEED_5000    = 0x0c,
-} CANUSB_SPEED;
-
-typedef enum {
-  CANUSB_MODE_NORMAL          = 0x00,
-  CANUSB_MODE_LOOPBACK        = 0x01,
-  CANUSB_MODE_SILENT          = 0x02,
-  CANUSB_MODE_LOOPBACK_SILENT = 0x03,
-} CANUSB_MODE;
-
-typedef enum {
-  CANUSB_FRAME_STANDARD = 0x01,
-  CANUSB_FRAME_EXTENDED = 0x02,
-} CANUSB_FRAME;
-
-typedef enum {
-  CANUSB_INJECT_PAYLOAD_MODE_RANDOM      = 0,
-  CANUSB_INJECT_PAYLOAD_MODE_INCREMENTAL = 1,
-  CANUSB_INJECT_PAYLOAD_MODE_FIXED       = 2,
-} CANUSB_PAYLOAD_MODE;
-
-typedef enum {
-  INFO    = 0,
-  WARN    = 1,
-  ERROR   = 2,
-} LOGGING_LEVEL;
-
-class LoggerClass {
-  public:
-    ofstream log_file;
-    void set_log_path(char* log_path) {
-      if (log_file.is_open()) {
-        log_file.close();
-      }
-      log_file.open(log_path);
-    }
-    void log(string string, LOGGING_LEVEL log_level) {
-      if (!log_file.is_open()) {
-        fprintf(stderr, "Log file not open!\n");
-        return;
-      }
-      char time_string[50];
-      time_t ts = time(NULL);
-      struct tm datetime = *localtime(&ts);
-      strftime(time_string, 50, "%F %H:%M:%S ", &datetime);
-      std::string print_string(time_string);
-      switch(log_level) {
-      case 0:
-        print_string.append("\033[1;37m[INFO] ");
-        break;
-      
-      case 1:
-        print_string.append("\033[1;33m[WARN] ");
-        break;
-
-      case 2:
-        print_string.append("\033[1;31m[ERROR] ");
-        break;
-      }
-
-      print_string.append(string).append("\033[0m\n");
-      log_file << print_string;
-    }
-    ~LoggerClass() {
-      if (log_file.is_open()) {
-        log_file.close();
-      }
-    }
-};
-
 // Global Variables
 static int program_running = 1;
-static int print_traffic = 0;
-
-char debug_output[4095];
-LoggerClass logger;
 
 
 // Function Prototypes
-static CANUSB_SPEED canusb_int_to_speed(int speed);
-static int generate_checksum(const unsigned char *data, int data_len);
-static int frame_is_complete(const unsigned char *frame, int frame_len);
-static int frame_send(int tty_fd, const unsigned char *frame, int frame_len);
-static int command_settings(int tty_fd, CANUSB_SPEED speed, CANUSB_MODE mode, CANUSB_FRAME frame);
-static int hex_value(int c);
-static int convert_from_hex(const char *hex_string, unsigned char *bin_string, int bin_string_len);
-static int send_data_frame(int tty_fd, const string hex_id, const char *hex_data);
-static void clear_buffer(int tty_fd);
-static void receive_frame(int tty_fd, unsigned char (&frame_out)[32]);
-static int adapter_init(const char *tty_device, int baudrate);
 static void display_help(const char *progname);
 static void sigterm(int signo);
 static void display_logo();
 static void display_menu(char* user_input);
-static void send_clear_cmd(int tty_fd, string inject_id);
-static void send_fill_cmd(int tty_fd, string inject_id);
-static void send_full_dump_cmd(int tty_fd, string inject_id);
-static void send_part_dump_cmd(int tty_fd, string inject_id);
-static void send_update_rtc_cmd(int tty_fd, string inject_id);
-static void print_frame(unsigned char *frame);
-static void read_frames_to_file(int tty_fd, char *bin_path, string cmd, int frame_count);
-static void save_frame(int tty_fd, ofstream& dump_file, int& i, bool& is_prev_frame_unknown);
+static int parse_payload_ids(const char *arg, vector<pair<unsigned short, unsigned short>>& payload_ids);
+static void update_rtc(RadmonGroup& radmon, int rtc_probes);
+static void report_round_trip(const char *label, RoundTripStats stats);
+static void apply_low_latency_profile(RadmonGroup& radmon, const char *tty_device, int io_cpu, int fifo_priority);
+static void read_frames_to_file(RadmonGroup& radmon, char *bin_path, string cmd, int frame_count);
+static double timed_full_dump(RadmonGroup& radmon, char *bin_path, string cmd, int *frames_lost, int *read_errors);
+static void run_load_test(RadmonGroup& radmon, char *bin_path, const LoadSpec& spec);
+static int sweep_dump(RadmonGroup& radmon, char *bin_path, SweepResult& result);
 
 
 
@@ -167,12 +76,32 @@ int main(int argc, char *argv[])
 {
   int c, tty_fd;
   char *tty_device = NULL, user_input;
-  CANUSB_SPEED speed = canusb_int_to_speed(CANUSB_CAN_SPEED_DEFAULT);
+  int speed_bps = CANUSB_CAN_SPEED_DEFAULT;
+  CANUSB_SPEED speed = canusb_int_to_speed(speed_bps);
   int baudrate = CANUSB_TTY_BAUD_RATE_DEFAULT;
   bool is_exit = false;
   bool is_test_mode = false;
-  unsigned char frame[32];
-  string inject_id, receive_id;
+  bool is_loopback_test = false;
+  bool is_load_test = false;
+  LoadSpec load_spec;
+  bool is_sweep = false;
+  SweepSpec sweep_spec;
+  bool is_verbose = false;
+  bool is_low_latency = false;
+  int io_cpu = -1;
+  int fifo_priority = 0;
+  unsigned short inject_id = RADMON_INJECT_ID_DEFAULT;
+  unsigned short receive_id = RADMON_RECEIVE_ID_DEFAULT;
+  vector<pair<unsigned short, unsigned short>> payload_ids;
+  int commit_records = DURABLE_COMMIT_RECORDS_DEFAULT;
+  int commit_ms = DURABLE_COMMIT_MS_DEFAULT;
+  int rtc_probes = RADMON_PROBE_COUNT_DEFAULT;
+  char *publish_path = NULL;
+  int reconnect_timeout_s = CANUSB_RECONNECT_TIMEOUT_DEFAULT;
+  bool is_range_dump_supported = false;
+  bool is_upset_check = false;
+  UpsetSpec upset_spec;
+  FramePublisher publisher;
 
   char *bin_path(argv[0]);
 
@@ -187,13 +116,10 @@ int main(int argc, char *argv[])
   strcat(log_path, time_string);
   strcat(log_path, ".log");
 
-  inject_id = CANUSB_INJECT_ID_DEFAULT;
-  receive_id = CANUSB_RECEIVE_ID_DEFAULT;
-
   logger.set_log_path(log_path);
   logger.log("Program started.", INFO);
 
-  while ((c = getopt(argc, argv, "htd:s:b:i:r:")) != -1) {
+  while ((c = getopt(argc, argv, "htvlLGc:f:d:s:b:i:r:p:y:R:g:S:P:T:a:U:H:")) != -1) {
     switch (c) {
     case 'h':
       display_help(argv[0]);
@@ -207,8 +133,9 @@ int main(int argc, char *argv[])
       break;
 
     case 's':
-      speed = canusb_int_to_speed(atoi(optarg));
-      sprintf(debug_output, "CAN speed set to: %d", atoi(optarg));
+      speed_bps = atoi(optarg);
+      speed = canusb_int_to_speed(speed_bps);
+      sprintf(debug_output, "CAN speed set to: %d", speed_bps);
       logger.log(debug_output, INFO);
       break;
 
@@ -219,21 +146,154 @@ int main(int argc, char *argv[])
       break;
 
     case 'i':
-      inject_id = optarg;
-      sprintf(debug_output, "Inject ID set to: %s", inject_id.c_str());
+      if (parse_can_id(optarg, &inject_id) == -1) {
+        fprintf(stderr, "Invalid inject ID: %s\n", optarg);
+        sprintf(debug_output, "Invalid inject ID %s, exiting.", optarg);
+        logger.log(debug_output, ERROR);
+        return EXIT_FAILURE;
+      }
+      sprintf(debug_output, "Inject ID set to: %03x", inject_id);
       logger.log(debug_output, INFO);
       break;
     
     case 'r':
-      receive_id = optarg;
-      sprintf(debug_output, "Receive ID set to: %s", receive_id.c_str());
+      if (parse_can_id(optarg, &receive_id) == -1) {
+        fprintf(stderr, "Invalid receive ID: %s\n", optarg);
+        sprintf(debug_output, "Invalid receive ID %s, exiting.", optarg);
+        logger.log(debug_output, ERROR);
+        return EXIT_FAILURE;
+      }
+      sprintf(debug_output, "Receive ID set to: %03x", receive_id);
       logger.log(debug_output, INFO);
       break;
     
+    case 'p':
+      if (parse_payload_ids(optarg, payload_ids) == -1) {
+        fprintf(stderr, "Invalid payload ID pair: %s\n", optarg);
+        sprintf(debug_output, "Invalid payload ID pair %s, exiting.", optarg);
+        logger.log(debug_output, ERROR);
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'y':
+      if (sscanf(optarg, "%d:%d", &commit_records, &commit_ms) < 1 || commit_records < 1) {
+        fprintf(stderr, "Invalid group commit policy: %s\n", optarg);
+        sprintf(debug_output, "Invalid group commit policy %s, exiting.", optarg);
+        logger.log(debug_output, ERROR);
+        return EXIT_FAILURE;
+      }
+      sprintf(debug_output, "Dump group commit set to: %d frames or %d ms", commit_records, commit_ms);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'R':
+      rtc_probes = atoi(optarg);
+      sprintf(debug_output, "RTC sync probes set to: %d", rtc_probes);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'g':
+      if (parse_load_spec(optarg, load_spec) == -1) {
+        fprintf(stderr, "Invalid load spec: %s\n", optarg);
+        display_help(argv[0]);
+        remove(log_path);
+        return EXIT_FAILURE;
+      }
+      is_load_test = true;
+      sprintf(debug_output, "Bus load test set to: %s", optarg);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'S':
+      if (parse_sweep_spec(optarg, sweep_spec) == -1) {
+        fprintf(stderr, "Invalid sweep spec: %s\n", optarg);
+        display_help(argv[0]);
+        remove(log_path);
+        return EXIT_FAILURE;
+      }
+      is_sweep = true;
+      sprintf(debug_output, "Link sweep set to: %s", optarg);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'G':
+      is_range_dump_supported = true;
+      logger.log("Payload ranged dumps enabled", INFO);
+      break;
+
+    case 'U':
+      if (parse_upset_spec(optarg, upset_spec) == -1) {
+        fprintf(stderr, "Invalid upset spec: %s\n", optarg);
+        display_help(argv[0]);
+        remove(log_path);
+        return EXIT_FAILURE;
+      }
+      is_upset_check = true;
+      sprintf(debug_output, "Upset check set to: %s", optarg);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'H':
+      upset_spec.hook = optarg;
+      is_upset_check = true;
+      sprintf(debug_output, "Upset hook set to: %s", optarg);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'a':
+      reconnect_timeout_s = atoi(optarg);
+      sprintf(debug_output, "Reconnect timeout set to: %d s", reconnect_timeout_s);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'P':
+      publish_path = optarg;
+      sprintf(debug_output, "Frame publish socket set to: %s", publish_path);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'T':
+      if (trace_start(optarg) == -1) {
+        remove(log_path);
+        return EXIT_FAILURE;
+      }
+      sprintf(debug_output, "Tracing to: %s", optarg);
+      logger.log(debug_output, INFO);
+      break;
+
     case 't':
       is_test_mode = true;
       break;
 
+    case 'L':
+      is_loopback_test = true;
+      break;
+
+    case 'v':
+      is_verbose = true;
+      logger.log("Verbose frame echo enabled.", INFO);
+      break;
+
+    case 'l':
+      is_low_latency = true;
+      logger.log("Low-latency profile enabled.", INFO);
+      break;
+
+    case 'c':
+      is_low_latency = true;
+      io_cpu = atoi(optarg);
+      sprintf(debug_output, "I/O CPU set to: %d", io_cpu);
+      logger.log(debug_output, INFO);
+      break;
+
+    case 'f':
+      is_low_latency = true;
+      fifo_priority = atoi(optarg);
+      sprintf(debug_output, "SCHED_FIFO priority set to: %d", fifo_priority);
+      logger.log(debug_output, INFO);
+      break;
+
     case '?':
     default:
       display_help(argv[0]);
@@ -255,9 +315,12 @@ int main(int argc, char *argv[])
   }
 
   if (speed == 0) {
-    fprintf(stderr, "Please specify a valid speed!\n");
-    display_help(argv[0]);
-    sprintf(debug_output, "CAN speed not specified, exiting.");
+    string valid_speeds;
+    for (int code = CANUSB_SPEED_1000000; code <= CANUSB_SPEED_5000; code++) {
+      valid_speeds += (valid_speeds.empty() ? "" : ", ") + to_string(canusb_speed_to_int((CANUSB_SPEED)code));
+    }
+    fprintf(stderr, "Unsupported CAN speed %d bps. Valid speeds: %s\n", speed_bps, valid_speeds.c_str());
+    sprintf(debug_output, "CAN speed %d bps not supported by the adapter, exiting.", speed_bps);
     logger.log(debug_output, ERROR);
     return EXIT_FAILURE;
   }
@@ -270,46 +333,119 @@ int main(int argc, char *argv[])
   }
 
   command_settings(tty_fd, speed, CANUSB_MODE_NORMAL, CANUSB_FRAME_STANDARD);
+  RadmonGroup radmon(tty_fd);
+  if (payload_ids.empty()) {
+    payload_ids.push_back({ inject_id, receive_id });
+  }
+  for (auto& ids : payload_ids) {
+    radmon.add_payload(ids.first, ids.second);
+  }
+  radmon.set_echo_frames(is_verbose);
+  radmon.set_commit_policy(commit_records, commit_ms);
+  radmon.set_range_dump_supported(is_range_dump_supported);
+  if (is_upset_check) {
+    radmon.set_upset_spec(upset_spec);
+  }
+  if (publish_path != NULL) {
+    if (publisher.start(publish_path) == -1) {
+      fprintf(stderr, "Unable to publish frames on %s\n", publish_path);
+      return EXIT_FAILURE;
+    }
+    radmon.set_publisher(&publisher);
+  }
+
+  if (is_low_latency) {
+    apply_low_latency_profile(radmon, tty_device, io_cpu, fifo_priority);
+  }
+
+  AdapterLink link;
+  link.tty_fd = tty_fd;
+  link.tty_device = tty_device;
+  link.baudrate = baudrate;
+  link.speed = speed;
+  link.is_low_latency = is_low_latency;
+  link.reconnect_timeout_s = reconnect_timeout_s;
+  if (reconnect_timeout_s > 0) {
+    radmon.set_link(&link);
+  }
   sprintf(debug_output, "Adapter initialized successfully.");
   logger.log(debug_output, INFO);
 
+  if (is_loopback_test) {
+    SelfTestReport report;
+    logger.log("Running loopback self-test.", INFO);
+    fprintf(stderr, "Running loopback self-test at %d bps CAN, %d baud serial.\n",
+            canusb_speed_to_int(speed), baudrate);
+    if (run_loopback_selftest(tty_fd, speed, CANUSB_MODE_LOOPBACK, report) < 0) {
+      logger.log("Loopback self-test failed to configure the adapter.", ERROR);
+      return EXIT_FAILURE;
+    }
+    print_selftest_report(report);
+    logger.log("Loopback self-test complete.", INFO);
+    return report.max_loss_free_step == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  if (is_sweep) {
+    SweepReport report;
+    SweepWorkload workload = [&](SweepResult& result) { return sweep_loopback(link.tty_fd, result); };
+    if (sweep_spec.workload == SWEEP_WORKLOAD_DUMP) {
+      workload = [&](SweepResult& result) { return sweep_dump(radmon, bin_path, result); };
+    } else {
+      link.mode = CANUSB_MODE_LOOPBACK;
+    }
+    logger.log("Running link sweep.", INFO);
+    if (run_link_sweep(link, sweep_spec, workload, report) == -1) {
+      fprintf(stderr, "Unable to restore the adapter settings after the sweep.\n");
+    }
+    print_sweep_report(report);
+    logger.log("Link sweep complete.", INFO);
+    return report.best == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  if (is_load_test) {
+    logger.log("Running bus load test.", INFO);
+    run_load_test(radmon, bin_path, load_spec);
+    logger.log("Bus load test complete.", INFO);
+    return EXIT_SUCCESS;
+  }
+
   display_logo();
 
   if (is_test_mode) {
     logger.log("Test mode enabled.", INFO);
-    usleep(3000000);
+    traced_usleep(3000000);
     logger.log("Updating RTC.", INFO);
     fprintf(stderr, "Updating RTC.\n");
-    send_update_rtc_cmd(tty_fd, inject_id);
-    usleep(3000000);
+    update_rtc(radmon, rtc_probes);
+    traced_usleep(3000000);
     logger.log("Running test cycle.", INFO);
     fprintf(stderr, "Running test cycle.\n");
     logger.log("Sending dump command.", INFO);
     fprintf(stderr, "Sending dump command.\n");
-    send_full_dump_cmd(tty_fd, inject_id);
-    usleep(1000000);
-    read_frames_to_file(tty_fd, bin_path, "test-cycle-dump", 8193);
-    usleep(1000000);
+    radmon.dump_full();
+    traced_usleep(1000000);
+    read_frames_to_file(radmon, bin_path, "test-cycle-dump", RADMON_FULL_DUMP_FRAMES);
+    traced_usleep(1000000);
     logger.log("Sending fill command.", INFO);
     fprintf(stderr, "Sending fill command.\n");
-    send_fill_cmd(tty_fd, inject_id);
-    usleep(10000000);
+    radmon.fill();
+    traced_usleep(10000000);
     logger.log("Sending dump command.", INFO);
     fprintf(stderr, "Sending dump command.\n");
-    send_full_dump_cmd(tty_fd, inject_id);
-    usleep(1000000);
-    read_frames_to_file(tty_fd, bin_path, "test-cycle-fill", 8193);
-    usleep(1000000);
+    radmon.dump_full();
+    traced_usleep(1000000);
+    read_frames_to_file(radmon, bin_path, "test-cycle-fill", RADMON_FULL_DUMP_FRAMES);
+    traced_usleep(1000000);
     logger.log("Sending clear command.", INFO);
     fprintf(stderr, "Sending clear command.\n");
-    send_clear_cmd(tty_fd, inject_id);
-    usleep(10000000);
+    radmon.clear();
+    traced_usleep(10000000);
     logger.log("Sending dump command.", INFO);
     fprintf(stderr, "Sending dump command.\n");
-    send_full_dump_cmd(tty_fd, inject_id);
-    usleep(1000000);
-    read_frames_to_file(tty_fd, bin_path, "test-cycle-clear", 8193);
-    usleep(1000000);
+    radmon.dump_full();
+    traced_usleep(1000000);
+    read_frames_to_file(radmon, bin_path, "test-cycle-clear", RADMON_FULL_DUMP_FRAMES);
+    traced_usleep(1000000);
     logger.log("Test cycle complete.", INFO);
     fprintf(stderr, "Test cycle complete.\n");
     return EXIT_SUCCESS;
@@ -323,40 +459,40 @@ int main(int argc, char *argv[])
       case '1':
         logger.log("Dumping FRAM (32kB) to console", INFO);
         fprintf(stderr, "Dumping FRAM (32kB) to console.\n");
-        send_full_dump_cmd(tty_fd, inject_id);
-        usleep(100000);
-        read_frames_to_file(tty_fd, bin_path, "dump-fram-32kb", 8193);
+        radmon.dump_full();
+        traced_usleep(100000);
+        read_frames_to_file(radmon, bin_path, "dump-fram-32kb", RADMON_FULL_DUMP_FRAMES);
         break;
       
       case '2':
         logger.log("Dumping FRAM (512B) to console", INFO);
         fprintf(stderr, "Dumping FRAM (512B) to console.\n");
-        send_part_dump_cmd(tty_fd, inject_id);
-        usleep(100000);
-        read_frames_to_file(tty_fd, bin_path, "dump-fram-512b", 128);
+        radmon.dump_part();
+        traced_usleep(100000);
+        read_frames_to_file(radmon, bin_path, "dump-fram-512b", RADMON_PART_DUMP_FRAMES);
         break;
       
       case '4':
         logger.log("Updating RTC", INFO);
         fprintf(stderr, "Updating RTC.\n");
-        send_update_rtc_cmd(tty_fd, inject_id);
-        usleep(100000);
+        update_rtc(radmon, rtc_probes);
+        traced_usleep(100000);
         break;
 
       case '6':
         logger.log("Clearing FRAM", INFO);
         fprintf(stderr, "Clearing FRAM.\n");
-        send_clear_cmd(tty_fd, inject_id);
-        usleep(100000);
-        receive_frame(tty_fd, frame);
+        radmon.clear();
+        traced_usleep(100000);
+        radmon.receive_responses();
         break;
 
       case '7':
         logger.log("Filling FRAM", INFO);
         fprintf(stderr, "Filling FRAM.\n");
-        send_fill_cmd(tty_fd, inject_id);
-        usleep(100000);
-        receive_frame(tty_fd, frame);
+        radmon.fill();
+        traced_usleep(100000);
+        radmon.receive_responses();
         break;
 
       case '8':
@@ -366,30 +502,30 @@ int main(int argc, char *argv[])
         fprintf(stderr, "Running test cycle.\n");
         logger.log("Sending dump command.", INFO);
         fprintf(stderr, "Sending dump command.\n");
-        send_full_dump_cmd(tty_fd, inject_id);
-        usleep(1000000);
-        read_frames_to_file(tty_fd, bin_path, "test-cycle-dump", 8193);
-        usleep(1000000);
+        radmon.dump_full();
+        traced_usleep(1000000);
+        read_frames_to_file(radmon, bin_path, "test-cycle-dump", RADMON_FULL_DUMP_FRAMES);
+        traced_usleep(1000000);
         logger.log("Sending fill command", INFO);
         fprintf(stderr, "Sending fill command.\n");
-        send_fill_cmd(tty_fd, inject_id);
-        usleep(5000000);
+        radmon.fill();
+        traced_usleep(5000000);
         logger.log("Sending dump command", INFO);
         fprintf(stderr, "Sending dump command.\n");
-        send_full_dump_cmd(tty_fd, inject_id);
-        usleep(1000000);
-        read_frames_to_file(tty_fd, bin_path, "test-cycle-fill", 8193);
-        usleep(1000000);
+        radmon.dump_full();
+        traced_usleep(1000000);
+        read_frames_to_file(radmon, bin_path, "test-cycle-fill", RADMON_FULL_DUMP_FRAMES);
+        traced_usleep(1000000);
         logger.log("Sending clear command", INFO);
         fprintf(stderr, "Sending clear command.\n");
-        send_clear_cmd(tty_fd, inject_id);
-        usleep(5000000);
+        radmon.clear();
+        traced_usleep(5000000);
         logger.log("Sending dump command", INFO);
         fprintf(stderr, "Sending dump command.\n");
-        send_full_dump_cmd(tty_fd, inject_id);
-        usleep(1000000);
-        read_frames_to_file(tty_fd, bin_path, "test-cycle-clear", 8193);
-        usleep(1000000);
+        radmon.dump_full();
+        traced_usleep(1000000);
+        read_frames_to_file(radmon, bin_path, "test-cycle-clear", RADMON_FULL_DUMP_FRAMES);
+        traced_usleep(1000000);
         logger.log("Test cycle complete", INFO);
         fprintf(stderr, "Test cycle complete.\n");
         break;
@@ -397,8 +533,8 @@ int main(int argc, char *argv[])
       case '9':
         logger.log("Clearing CANbus buffer", INFO);
         fprintf(stderr, "Clearing CANbus buffer.\n");
-        clear_buffer(tty_fd);
-        usleep(100000);
+        radmon.clear_buffer();
+        traced_usleep(100000);
         break;
 
       case '0':
@@ -422,410 +558,6 @@ int main(int argc, char *argv[])
 
 
 // Function Definitions
-static CANUSB_SPEED canusb_int_to_speed(int speed)
-{
-  switch (speed) {
-  case 1000000:
-    return CANUSB_SPEED_1000000;
-  case 800000:
-    return CANUSB_SPEED_800000;
-  case 500000:
-    return CANUSB_SPEED_500000;
-  case 400000:
-    return CANUSB_SPEED_400000;
-  case 250000:
-    return CANUSB_SPEED_250000;
-  case 200000:
-    return CANUSB_SPEED_200000;
-  case 125000:
-    return CANUSB_SPEED_125000;
-  case 100000:
-    return CANUSB_SPEED_100000;
-  case 50000:
-    return CANUSB_SPEED_50000;
-  case 20000:
-    return CANUSB_SPEED_20000;
-  case 10000:
-    return CANUSB_SPEED_10000;
-  case 5000:
-    return CANUSB_SPEED_5000;
-  default:
-    return CANUSB_SPEED_500000;
-  }
-}
-
-
-
-static int generate_checksum(const unsigned char *data, int data_len)
-{
-  int i, checksum;
-
-  checksum = 0;
-  for (i = 0; i < data_len; i++) {
-    checksum += data[i];
-  }
-
-  return checksum & 0xff;
-}
-
-
-
-static int frame_is_complete(const unsigned char *frame, int frame_len)
-{
-  if (frame_len > 0) {
-    if (frame[0] != 0xaa) {
-      /* Need to sync on 0xaa at start of frames, so just skip. */
-      return 1;
-    }
-  }
-
-  if (frame_len < 2) {
-    return 0;
-  }
-
-  if (frame[1] == 0x55) { /* Command frame... */
-    if (frame_len >= 20) { /* ...always 20 bytes. */
-      return 1;
-    } else {
-      return 0;
-    }
-  } else if ((frame[1] >> 4) == 0xc) { /* Data frame... */
-    if (frame_len >= (frame[1] & 0xf) + 5) { /* ...payload and 5 bytes. */
-      return 1;
-    } else {
-      return 0;
-    }
-  }
-
-  /* Unhandled frame type. */
-  return 1;
-}
-
-
-
-static int frame_send(int tty_fd, const unsigned char *frame, int frame_len)
-{
-  int result, i;
-  char temp_string[4095];
-
-  if (print_traffic) {
-    printf(">>> ");
-    sprintf(debug_output, ">>> ");
-    for (i = 0; i < frame_len; i++) {
-      printf("%02x ", frame[i]);
-      sprintf(temp_string, "%02x ", frame[i]);
-      strcat(debug_output, temp_string);
-    }
-    if (print_traffic > 1) {
-      printf("    '");
-      sprintf(temp_string, "    '");
-      strcat(debug_output, temp_string);
-      for (i = 4; i < frame_len - 1; i++) {
-        printf("%c", isalnum(frame[i]) ? frame[i] : '.');
-        sprintf(temp_string, "%c", isalnum(frame[i]) ? frame[i] : '.');
-        strcat(debug_output, temp_string);
-      }
-      printf("'");
-      sprintf(temp_string, "'");
-      strcat(debug_output, temp_string);
-    }
-    printf("\n");
-    logger.log(debug_output, INFO);
-  }
-
-  result = write(tty_fd, frame, frame_len);
-  if (result == -1) {
-    fprintf(stderr, "write() failed: %s\n", strerror(errno));
-    return -1;
-  }
-
-  return frame_len;
-}
-
-
-
-static int command_settings(int tty_fd, CANUSB_SPEED speed, CANUSB_MODE mode, CANUSB_FRAME frame)
-{
-  int cmd_frame_len;
-  unsigned char cmd_frame[20];
-
-  cmd_frame_len = 0;
-  cmd_frame[cmd_frame_len++] = 0xaa;
-  cmd_frame[cmd_frame_len++] = 0x55;
-  cmd_frame[cmd_frame_len++] = 0x12;
-  cmd_frame[cmd_frame_len++] = speed;
-  cmd_frame[cmd_frame_len++] = frame;
-  cmd_frame[cmd_frame_len++] = 0; /* Filter ID not handled. */
-  cmd_frame[cmd_frame_len++] = 0; /* Filter ID not handled. */
-  cmd_frame[cmd_frame_len++] = 0; /* Filter ID not handled. */
-  cmd_frame[cmd_frame_len++] = 0; /* Filter ID not handled. */
-  cmd_frame[cmd_frame_len++] = 0; /* Mask ID not handled. */
-  cmd_frame[cmd_frame_len++] = 0; /* Mask ID not handled. */
-  cmd_frame[cmd_frame_len++] = 0; /* Mask ID not handled. */
-  cmd_frame[cmd_frame_len++] = 0; /* Mask ID not handled. */
-  cmd_frame[cmd_frame_len++] = mode;
-  cmd_frame[cmd_frame_len++] = 0x01;
-  cmd_frame[cmd_frame_len++] = 0;
-  cmd_frame[cmd_frame_len++] = 0;
-  cmd_frame[cmd_frame_len++] = 0;
-  cmd_frame[cmd_frame_len++] = 0;
-  cmd_frame[cmd_frame_len++] = generate_checksum(&cmd_frame[2], 17);
-
-  if (frame_send(tty_fd, cmd_frame, cmd_frame_len) < 0) {
-    return -1;
-  }
-
-  return 0;
-}
-
-
-
-static int hex_value(int c)
-{
-  if (c >= 0x30 && c <= 0x39) /* '0' - '9' */
-    return c - 0x30;
-  else if (c >= 0x41 && c <= 0x46) /* 'A' - 'F' */
-    return (c - 0x41) + 10;
-  else if (c >= 0x61 && c <= 0x66) /* 'a' - 'f' */
-    return (c - 0x61) + 10;
-  else
-    return -1;
-}
-
-
-
-static int convert_from_hex(const char *hex_string, unsigned char *bin_string, int bin_string_len)
-{
-  int n1, n2, high;
-
-  high = -1;
-  n1 = n2 = 0;
-  while (hex_string[n1] != '\0') {
-    if (hex_value(hex_string[n1]) >= 0) {
-      if (high == -1) {
-        high = hex_string[n1];
-      } else {
-        bin_string[n2] = hex_value(high) * 16 + hex_value(hex_string[n1]);
-        n2++;
-        if (n2 >= bin_string_len) {
-          printf("hex string truncated to %d bytes\n", n2);
-          break;
-        }
-        high = -1;
-      }
-    }
-    n1++;
-  }
-
-  return n2;
-}
-
-
-
-static int send_data_frame(int tty_fd, const string hex_id, const char *hex_data)
-{
-  int data_len;
-  unsigned char binary_data[8];
-  unsigned char binary_id_lsb = 0, binary_id_msb = 0;
-
-  data_len = convert_from_hex(hex_data, binary_data, sizeof(binary_data));
-  if (data_len == 0) {
-    fprintf(stderr, "Unable to convert data from hex to binary!\n");
-    logger.log("Unable to convert data from hex to binary!", ERROR);
-    return -1;
-  }
-
-  switch (hex_id.length()) {
-    case 1:
-      binary_id_lsb = hex_value(hex_id[0]);
-      break;
-  
-    case 2:
-      binary_id_lsb = (hex_value(hex_id[0]) * 16) + hex_value(hex_id[1]);
-      break;
-  
-    case 3:
-      binary_id_msb = hex_value(hex_id[0]);
-      binary_id_lsb = (hex_value(hex_id[1]) * 16) + hex_value(hex_id[2]);
-      break;
-  
-    default:
-      fprintf(stderr, "Unable to convert ID from hex to binary!\n");
-      logger.log("Unable to convert ID from hex to binary!", ERROR);
-      return -1;
-  }
-
-  CANUSB_FRAME frame = CANUSB_FRAME_STANDARD;
-
-  #define MAX_FRAME_SIZE 13
-  int data_frame_len = 0;
-  unsigned char data_frame[MAX_FRAME_SIZE] = {0x00};
-
-  if (data_len < 0 || data_len > 8)
-  {
-    fprintf(stderr, "Data length code (DLC) must be between 0 and 8!\n");
-    logger.log("Data length code (DLC) must be between 0 and 8!", ERROR);
-    return -1;
-  }
-
-  /* Byte 0: Packet Start */
-  data_frame[data_frame_len++] = 0xaa;
-
-  /* Byte 1: CAN Bus Data Frame Information */
-  data_frame[data_frame_len] = 0x00;
-  data_frame[data_frame_len] |= 0xC0; /* Bit 7 Always 1, Bit 6 Always 1 */
-  if (frame == CANUSB_FRAME_STANDARD)
-    data_frame[data_frame_len] &= 0xDF; /* STD frame */
-  else /* CANUSB_FRAME_EXTENDED */
-    data_frame[data_frame_len] |= 0x20; /* EXT frame */
-  data_frame[data_frame_len] &= 0xEF; /* 0=Data */
-  data_frame[data_frame_len] |= data_len; /* DLC=data_len */
-  data_frame_len++;
-
-  /* Byte 2 to 3: ID */
-  data_frame[data_frame_len++] = binary_id_lsb; /* lsb */
-  data_frame[data_frame_len++] = binary_id_msb; /* msb */
-
-  /* Byte 4 to (4+data_len): Data */
-  for (int i = 0; i < data_len; i++)
-    data_frame[data_frame_len++] = binary_data[i];
-
-  /* Last byte: End of frame */
-  data_frame[data_frame_len++] = 0x55;
-
-  if (frame_send(tty_fd, data_frame, data_frame_len) < 0)
-  {
-    fprintf(stderr, "Unable to send frame!\n");
-    logger.log("Unable to send frame!", ERROR);
-    return -1;
-  }
-
-  return 0;
-}
-
-
-
-static void clear_buffer(int tty_fd)
-{
-  int is_buffer_filled = 1;
-  int result;
-  unsigned char byte;
-
-  while (is_buffer_filled) {
-    result = read(tty_fd, &byte, 1);
-    if (result != 1) {
-      is_buffer_filled = 0;
-      return;
-    }
-    usleep(2);
-  }
-  return;
-}
-
-
-
-static void receive_frame(int tty_fd, unsigned char (&frame_out)[32])
-{
-  int frame_len = 0;
-  unsigned char frame[32];
-
-  int result, checksum;
-  unsigned char byte;
-
-  int is_frame_complete = 0;
-  char temp_string[4095];
-
-  frame_len = 0;
-  while (!is_frame_complete) {
-    result = read(tty_fd, &byte, 1);
-    if (result == -1) {
-      fprintf(stderr, "read() failed: %s\n", strerror(errno));
-      logger.log("read() failed!", ERROR);
-      return;
-      
-    } else if (result > 0) {
-      if (print_traffic) {
-        fprintf(stderr, "%02x ", byte);
-        sprintf(temp_string, "%02x ", byte);
-        strcat(debug_output, temp_string);
-      }
-
-      frame[frame_len++] = byte;
-
-      if (frame_is_complete(frame, frame_len)) {
-        is_frame_complete = 1;
-        break;
-      }
-    } else {
-      return;
-    }
-    usleep(2);
-  }
-  if (print_traffic) {
-    logger.log(debug_output, INFO);
-  }
-
-  if ((frame_len == 20) && (frame[0] == 0xaa) && (frame[1] == 0x55)) {
-    checksum = generate_checksum(&frame[2], 17);
-    if (checksum != frame[frame_len - 1]) {
-      fprintf(stderr, "receive_frame() failed: Checksum incorrect\n");
-      logger.log("receive_frame() failed: Checksum incorrect", ERROR);
-      return;
-    }
-  }
-
-  if (frame_len == -1) {
-    printf("Frame recieve error!\n");
-    logger.log("Frame recieve error!", ERROR);
-  } else {
-    print_frame(frame);
-
-    for (int i=0; i<frame_len; i++) {
-      frame_out[i] = frame[i];
-    }
-  }
-}
-
-
-
-static int adapter_init(const char *tty_device, int baudrate)
-{
-  int tty_fd, result;
-  struct termios2 tio;
-
-  tty_fd = open(tty_device, O_RDWR | O_NOCTTY | O_NONBLOCK);
-  if (tty_fd == -1) {
-    fprintf(stderr, "open(%s) failed: %s\n", tty_device, strerror(errno));
-    return -1;
-  }
-
-  result = ioctl(tty_fd, TCGETS2, &tio);
-  if (result == -1) {
-    fprintf(stderr, "ioctl() failed: %s\n", strerror(errno));
-    close(tty_fd);
-    return -1;
-  }
-
-  tio.c_cflag &= ~CBAUD;
-  tio.c_cflag = BOTHER | CS8 | CSTOPB;
-  tio.c_iflag = IGNPAR;
-  tio.c_oflag = 0;
-  tio.c_lflag = 0;
-  tio.c_ispeed = baudrate;
-  tio.c_ospeed = baudrate;
-
-  result = ioctl(tty_fd, TCSETS2, &tio);
-  if (result == -1) {
-    fprintf(stderr, "ioctl() failed: %s\n", strerror(errno));
-    close(tty_fd);
-    return -1;
-  }
-
-  return tty_fd;
-}
-
-
-
 static void display_help(const char *progname)
 {
   fprintf(stderr, "Usage: %s <options>\n", progname);
@@ -836,9 +568,45 @@ static void display_help(const char *progname)
      "  -b BAUDRATE Set TTY/serial BAUDRATE (default: %d).\n"
      "  -i SEND_ID  Inject using ID (specified as hex string).\n"
      "  -r RECV_ID  Receive using ID (specified as hex string).\n"
+     "  -p SEND_ID:RECV_ID\n"
+     "              Add a payload on the same bus (repeatable, replaces -i/-r).\n"
+     "  -y N[:MS]   fsync dumps every N frames or MS milliseconds (default: %d:%d).\n"
+     "  -a SECONDS  Reconnect a lost adapter for up to SECONDS, 0 to give up at once (default: %d).\n"
+     "  -G          The payload answers ranged dumps: re-fetch lost frames anywhere in a\n"
+     "              dump, not only in the first %d.\n"
+     "  -U THRESHOLD[:FLIPS/FRAMES[:PATTERN]]\n"
+     "              Check dumps for upsets as they arrive and alert when a 2kB region reaches\n"
+     "              THRESHOLD flipped bits or FLIPS fall within FRAMES frames, 0 for no alert\n"
+     "              (default: %d:%d/%d). Dumps are compared with the last fill or clear, or\n"
+     "              with PATTERN (fill, clear or a hex byte) when there was none.\n"
+     "  -H COMMAND  Run COMMAND through the shell on every upset alert (implies -U).\n"
+     "  -T FILE     Record a Chrome trace-event timeline to FILE.\n"
+     "  -P SOCKET   Publish every dump frame to subscribers on UNIX socket SOCKET.\n"
+     "  -R PROBES   Round-trip probes for RTC sync, 0 to send the time at once (default: %d).\n"
+     "  -L          Run the adapter loopback self-test and exit.\n"
+     "  -g RATE[:MODE[:ID,...]]\n"
+     "              Compare a full dump on a quiet bus with one under generated load and exit.\n"
+     "              MODE is random, incremental or fixed hex data (default: random, ID %03x).\n"
+     "  -S SPEEDS:BAUDRATES[:WORKLOAD]\n"
+     "              Sweep comma-separated CAN speeds and serial baudrates, empty for the defaults,\n"
+     "              recommend the fastest loss-free pair and exit. WORKLOAD is loopback (default)\n"
+     "              or dump, which needs a payload that follows the adapter's speed.\n"
+     "  -v          Echo every dump frame instead of the progress view.\n"
+     "  -l          Use the low-latency serial profile and report round-trip latency.\n"
+     "  -c CPU      Pin the I/O thread to CPU (implies -l).\n"
+     "  -f PRIORITY Run the I/O thread SCHED_FIFO at PRIORITY (implies -l).\n"
      "\n",
      CANUSB_CAN_SPEED_DEFAULT,
-     CANUSB_TTY_BAUD_RATE_DEFAULT);
+     CANUSB_TTY_BAUD_RATE_DEFAULT,
+     DURABLE_COMMIT_RECORDS_DEFAULT,
+     DURABLE_COMMIT_MS_DEFAULT,
+     CANUSB_RECONNECT_TIMEOUT_DEFAULT,
+     RADMON_PART_DUMP_FRAMES,
+     UPSET_THRESHOLD_DEFAULT,
+     UPSET_BURST_FLIPS_DEFAULT,
+     UPSET_BURST_FRAMES_DEFAULT,
+     RADMON_PROBE_COUNT_DEFAULT,
+     LOAD_ID_DEFAULT);
 }
 
 
@@ -889,93 +657,72 @@ static void display_menu(char* user_input)
 
 
 
-static void send_clear_cmd(int tty_fd, string inject_id)
+/* Parses "SEND_ID:RECV_ID", both as hex strings like -i and -r. */
+static int parse_payload_ids(const char *arg, vector<pair<unsigned short, unsigned short>>& payload_ids)
 {
-  char data[] = { '0', '1' };
-  send_data_frame(tty_fd, inject_id, data);
-  return;
-}
-
+  char inject_string[8], receive_string[8];
+  unsigned short inject_id, receive_id;
 
+  if (sscanf(arg, "%7[0-9a-fA-F]:%7[0-9a-fA-F]", inject_string, receive_string) != 2) {
+    return -1;
+  }
+  if (parse_can_id(inject_string, &inject_id) == -1 || parse_can_id(receive_string, &receive_id) == -1) {
+    return -1;
+  }
 
-static void send_fill_cmd(int tty_fd, string inject_id)
-{
-  char data[] = { 'E', 'F' };
-  send_data_frame(tty_fd, inject_id, data);
-  return;
+  payload_ids.push_back({ inject_id, receive_id });
+  return 0;
 }
 
 
 
-static void send_full_dump_cmd(int tty_fd, string inject_id)
+static void update_rtc(RadmonGroup& radmon, int rtc_probes)
 {
-  char data[] = { '0', '2' };
-  send_data_frame(tty_fd, inject_id, data);
-  return;
+  if (rtc_probes == 0) {
+    radmon.set_rtc(time(NULL));
+    return;
+  }
+  radmon.sync_rtc(rtc_probes);
 }
 
 
 
-static void send_part_dump_cmd(int tty_fd, string inject_id)
+static void report_round_trip(const char *label, RoundTripStats stats)
 {
-  char data[] = { '0', '4' };
-  send_data_frame(tty_fd, inject_id, data);
-  return;
+  if (stats.count == 0) {
+    sprintf(debug_output, "Round-trip latency %s: no response to %d probes", label, RADMON_PROBE_COUNT_DEFAULT);
+    logger.log(debug_output, WARN);
+  } else {
+    sprintf(debug_output, "Round-trip latency %s: min %.2f ms, median %.2f ms, max %.2f ms (%d/%d probes)",
+            label, stats.min_us / 1000, stats.median_us / 1000, stats.max_us / 1000,
+            stats.count, RADMON_PROBE_COUNT_DEFAULT);
+    logger.log(debug_output, INFO);
+  }
+  fprintf(stderr, "%s.\n", debug_output);
 }
 
 
 
-static void send_update_rtc_cmd(int tty_fd, string inject_id)
+static void apply_low_latency_profile(RadmonGroup& radmon, const char *tty_device, int io_cpu, int fifo_priority)
 {
-  char temp_string[4095];
-  time_t ts = time(NULL);
-  printf("Current time: %ld\n", ts);
-  sprintf(temp_string, "Current time: %ld", ts);
-  logger.log(temp_string, INFO);
-  // separate ts into 8 bytes
-  char hex_string[9];
-  sprintf(hex_string, "%lx", ts);
-  char data[] = { 'A', 'A', hex_string[0], hex_string[1], hex_string[2], hex_string[3], hex_string[4], hex_string[5], hex_string[6], hex_string[7] };
-  //char data[] = { 'A', 'A', '6', '7', 'D', '5', '3', 'F', 'A', 'A' };
-  send_data_frame(tty_fd, inject_id, data);
-  return;
-}
-
+  report_round_trip("before low-latency profile", radmon.measure_round_trip(RADMON_PROBE_COUNT_DEFAULT));
 
-
-static void print_frame(unsigned char *frame)
-{
-  int i;
-  int frame_len = sizeof(frame);
-  char temp_string[4095];
-  if ((frame_len >= 6) && (frame[0] == 0xaa) && ((frame[1] >> 4) == 0xc)) {
-    printf("Frame ID: %02x%02x, Data: ", frame[3], frame[2]);
-    sprintf(debug_output, "Frame ID: %02x%02x, Data: ", frame[3], frame[2]);
-    logger.log(debug_output, INFO);
-    sprintf(debug_output, " ");
-    for (i = 4; i < 12; i++) {
-      printf("%02x ", frame[i]);
-      sprintf(temp_string, "%02x ", frame[i]);
-      strcat(debug_output, temp_string);
-    }
-    printf("\n");
-    logger.log(debug_output, INFO);
-  } else {
-    printf("Unknown: ");
-    sprintf(debug_output, "Unknown: ");
-    for (i = 0; i <= frame_len; i++) {
-      printf("%02x ", frame[i]);
-      sprintf(temp_string, "%02x ", frame[i]);
-      strcat(debug_output, temp_string);
-    }
-    printf("\n");
-    logger.log(debug_output, INFO);
+  if (adapter_set_low_latency(radmon.tty_fd, tty_device) == -1) {
+    logger.log("Unable to apply low-latency serial settings", ERROR);
+  }
+  if (io_cpu >= 0) {
+    pin_thread_to_cpu(io_cpu);
   }
+  if (fifo_priority > 0) {
+    set_thread_fifo(fifo_priority);
+  }
+
+  report_round_trip("after low-latency profile", radmon.measure_round_trip(RADMON_PROBE_COUNT_DEFAULT));
 }
 
 
 
-static void read_frames_to_file(int tty_fd, char *bin_path, string cmd, int frame_count)
+static void read_frames_to_file(RadmonGroup& radmon, char *bin_path, string cmd, int frame_count)
 {
   time_t ts = time(NULL);
   struct tm datetime = *localtime(&ts);
@@ -989,101 +736,102 @@ static void read_frames_to_file(int tty_fd, char *bin_path, string cmd, int fram
   strcat(dump_path, time_string);
   sprintf(cmd_string, "%s", cmd.c_str());
   strcat(dump_path, cmd_string);
-  strcat(dump_path, ".txt");
 
-  ofstream dump_file(dump_path);
-
-  int i = 0;
-  bool is_prev_frame_unknown = false;
-  while (i < frame_count) {
-    save_frame(tty_fd, dump_file, i, is_prev_frame_unknown);
+  vector<string> dump_paths;
+  if (radmon.payloads.size() == 1) {
+    dump_paths.push_back(string(dump_path) + ".txt");
+  } else {
+    for (auto& payload : radmon.payloads) {
+      char id_string[8];
+      sprintf(id_string, "-%03x", payload->inject_id);
+      dump_paths.push_back(string(dump_path) + id_string + ".txt");
+    }
   }
 
-  dump_file.close();
+  Dashboard dashboard;
+  if (!radmon.echo_frames()) {
+    dashboard.start(&radmon.stats(), cmd);
+  }
+  radmon.read_frames_to_files(dump_paths, frame_count);
+  dashboard.stop();
   return;
 }
 
 
 
-static void save_frame(int tty_fd, ofstream& dump_file, int& i, bool& is_prev_frame_unknown)
+/* Sends a full dump and saves it, returning the seconds from command to last
+ * frame. Every frame that did not arrive intact counts as lost, whether or
+ * not the repair got it back; failed reads are counted apart. */
+static double timed_full_dump(RadmonGroup& radmon, char *bin_path, string cmd, int *frames_lost, int *read_errors)
 {
-  int frame_len = 0;
-  unsigned char frame[32];
-
-  int result, checksum;
-  unsigned char byte;
-
-  int is_frame_complete = 0;
-  char temp_string[4095];
-
-  sprintf(debug_output, " ");
-  frame_len = 0;
-  while (!is_frame_complete) {
-    result = read(tty_fd, &byte, 1);
-    if (result == -1) {
-      fprintf(stderr, "read() failed: %s\n", strerror(errno));
-      sprintf(debug_output, "read() failed: %s\n", strerror(errno));
-      logger.log(debug_output, ERROR);
-      i++;
-      return;
-      
-    } else if (result > 0) {
-      if (print_traffic) {
-        fprintf(stderr, "%02x ", byte);
-        sprintf(temp_string, "%02x ", byte);
-        strcat(debug_output, temp_string);
-      }
+  struct timespec start, end;
+  const DumpStats& stats = radmon.stats();
+
+  radmon.clear_buffer();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  radmon.dump_full();
+  read_frames_to_file(radmon, bin_path, cmd, RADMON_FULL_DUMP_FRAMES);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  *frames_lost = stats.frames_expected.load(memory_order_relaxed) - stats.frames_intact.load(memory_order_relaxed);
+  *read_errors = stats.read_errors.load(memory_order_relaxed);
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
 
-      frame[frame_len++] = byte;
 
-      if (frame_is_complete(frame, frame_len)) {
-        is_frame_complete = 1;
-        break;
-      }
-    } else {
-      i++;
-      return;
-    }
-    usleep(2);
-  }
 
-  if ((frame_len == 20) && (frame[0] == 0xaa) && (frame[1] == 0x55)) {
-    checksum = generate_checksum(&frame[2], 17);
-    if (checksum != frame[frame_len - 1]) {
-      fprintf(stderr, "receive_frame() failed: Checksum incorrect\n");
-      logger.log("receive_frame() failed: Checksum incorrect", ERROR);
-      return;
-    }
-  }
+/* Runs a full dump on a quiet bus, then another while the generator loads
+ * the bus, and reports the load achieved against the dump's slowdown. */
+static void run_load_test(RadmonGroup& radmon, char *bin_path, const LoadSpec& spec)
+{
+  LoadGenerator generator;
+  double quiet_seconds, loaded_seconds;
+  int quiet_lost, loaded_lost, quiet_read_errors, loaded_read_errors;
+
+  fprintf(stderr, "Full dump on a quiet bus.\n");
+  quiet_seconds = timed_full_dump(radmon, bin_path, "load-quiet", &quiet_lost, &quiet_read_errors);
+
+  fprintf(stderr, "Full dump under load.\n");
+  generator.start(radmon.tty_fd, spec);
+  loaded_seconds = timed_full_dump(radmon, bin_path, "load-busy", &loaded_lost, &loaded_read_errors);
+  generator.stop();
+
+  printf("Load: target %d frames/s, achieved %.0f frames/s (%ld sent, %ld failed)\n",
+         spec.rate > 0 ? spec.rate : 1000 / CANUSB_INJECT_SLEEP_GAP_DEFAULT, generator.achieved_rate(),
+         generator.frames_sent.load(), generator.send_errors.load());
+  printf("Quiet dump: %.2f s, %d frames lost, %d read errors\n", quiet_seconds, quiet_lost, quiet_read_errors);
+  printf("Loaded dump: %.2f s (%+.0f%%), %d frames lost, %d read errors\n", loaded_seconds,
+         (loaded_seconds / quiet_seconds - 1) * 100, loaded_lost, loaded_read_errors);
+
+  sprintf(debug_output, "Load %.0f frames/s: dump %.2f s -> %.2f s, lost %d -> %d, read errors %d -> %d, %ld load frames failed",
+          generator.achieved_rate(), quiet_seconds, loaded_seconds, quiet_lost, loaded_lost,
+          quiet_read_errors, loaded_read_errors, generator.send_errors.load());
+  logger.log(debug_output, loaded_lost > quiet_lost || loaded_read_errors > quiet_read_errors
+                           || generator.send_errors.load() ? WARN : INFO);
+}
 
-  if (frame_len == -1) {
-    printf("Frame recieve error!\n");
-    logger.log("Frame recieve error!", ERROR);
-  } else {
-    if ((frame_len >= 6) && (frame[0] == 0xaa) && ((frame[1] >> 4) == 0xc)) {
-      printf("Frame ID: %02x%02x, Data: ", frame[3], frame[2]);
-      dump_file << "Frame ID: " << hex << (int)frame[3] << (int)frame[2] << dec << ", Data: ";
-      for (int j = 4; j < 12; j++) {
-        printf("%02x ", (int)frame[j]);
-        dump_file << hex << setw(2) << setfill('0') << (int)frame[j] << dec << " ";
-      }
-      printf("\n");
-      dump_file << "\n" << ends;
-      i++;
-      is_prev_frame_unknown = false;
-    } else {
-      printf("Unknown: ");
-      dump_file << "Unknown: ";
-      for (int j = 0; j <= frame_len; j++) {
-        printf("%02x ", frame[j]);
-        dump_file << hex << (int)frame[j] << dec << " ";
-      }
-      printf("\n");
-      dump_file << "\n";
-      if (!is_prev_frame_unknown) {
-        i++;
-      }
-      is_prev_frame_unknown = true;
-    }
-  }
+
+
+/* The dump workload of a link sweep: one timed full dump, then round-trip
+ * probes for latency. Each dump is kept, named after its settings. */
+static int sweep_dump(RadmonGroup& radmon, char *bin_path, SweepResult& result)
+{
+  const DumpStats& stats = radmon.stats();
+  char cmd[64];
+  int frames_lost, read_errors;
+
+  sprintf(cmd, "sweep-%d-%d", result.speed, result.baudrate);
+  double seconds = timed_full_dump(radmon, bin_path, cmd, &frames_lost, &read_errors);
+  result.frames = stats.frames_expected.load(memory_order_relaxed) - frames_lost;
+  result.throughput = result.frames / seconds;
+  result.lost = frames_lost;
+  result.errors = stats.checksum_errors.load(memory_order_relaxed) + stats.unknown_frames.load(memory_order_relaxed)
+                  + stats.uart_overruns.load(memory_order_relaxed) + stats.buffer_overruns.load(memory_order_relaxed)
+                  + stats.framing_errors.load(memory_order_relaxed) + stats.parity_errors.load(memory_order_relaxed)
+                  + read_errors;
+
+  RoundTripStats round_trip = radmon.measure_round_trip(RADMON_PROBE_COUNT_DEFAULT);
+  result.latency_us = round_trip.median_us;
+  result.latency_worst_us = round_trip.max_us;
+  return 0;
 }
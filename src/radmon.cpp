@@ -0,0 +1,812 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "logger.h"
+#include "radmon.h"
+#include "tracer.h"
+
+using namespace std;
+
+// Compile-time checks of the pre-encoded command frames
+static_assert(encode_command_frame(RADMON_INJECT_ID_DEFAULT, RADMON_CMD_FULL_DUMP).len == 6);
+static_assert(encode_command_frame(RADMON_INJECT_ID_DEFAULT, RADMON_CMD_FULL_DUMP).bytes[1] == 0xc1);
+static_assert(encode_command_frame(RADMON_INJECT_ID_DEFAULT, RADMON_CMD_FULL_DUMP).bytes[2] == 0x10);
+static_assert(encode_rtc_frame(RADMON_INJECT_ID_DEFAULT, 0x67d53faa).len == 10);
+static_assert(encode_rtc_frame(RADMON_INJECT_ID_DEFAULT, 0x67d53faa).bytes[5] == 0x67);
+static_assert(encode_rtc_frame(RADMON_INJECT_ID_DEFAULT, 0x67d53faa).bytes[8] == 0xaa);
+static_assert(encode_range_dump_frame(RADMON_INJECT_ID_DEFAULT, 0x1234, 0x0056).len == 10);
+static_assert(encode_range_dump_frame(RADMON_INJECT_ID_DEFAULT, 0x1234, 0x0056).bytes[5] == 0x12);
+static_assert(encode_range_dump_frame(RADMON_INJECT_ID_DEFAULT, 0x1234, 0x0056).bytes[8] == 0x56);
+
+
+
+// Function Definitions
+RadmonClient::RadmonClient(int tty_fd, unsigned short inject_id, unsigned short receive_id)
+  : RadmonClient(make_shared<SerialReader>(tty_fd), inject_id, receive_id)
+{
+}
+
+
+
+RadmonClient::RadmonClient(shared_ptr<SerialReader> reader, unsigned short inject_id, unsigned short receive_id)
+  : tty_fd(reader->tty_fd), inject_id(inject_id), receive_id(receive_id), reader(reader),
+    clear_frame(encode_command_frame(inject_id, RADMON_CMD_CLEAR)),
+    fill_frame(encode_command_frame(inject_id, RADMON_CMD_FILL)),
+    full_dump_frame(encode_command_frame(inject_id, RADMON_CMD_FULL_DUMP)),
+    part_dump_frame(encode_command_frame(inject_id, RADMON_CMD_PART_DUMP))
+{
+}
+
+
+
+/* A send that fails because the adapter dropped off is retried once the
+ * link has been recovered. */
+int RadmonClient::send_frame(const CanusbDataFrame& frame)
+{
+  if (frame_send(tty_fd, frame.bytes, frame.len) < 0
+      && !(link != nullptr && is_device_lost(errno) && recover_link() == 0
+           && frame_send(tty_fd, frame.bytes, frame.len) >= 0)) {
+    fprintf(stderr, "Unable to send frame!\n");
+    logger.log("Unable to send frame!", ERROR);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+
+int RadmonClient::clear()
+{
+  TRACE_SPAN("clear", "command");
+  int result = send_frame(clear_frame);
+  if (result == 0) {
+    memory_pattern = UPSET_CLEAR_PATTERN;
+  }
+  return result;
+}
+
+
+
+int RadmonClient::fill()
+{
+  TRACE_SPAN("fill", "command");
+  int result = send_frame(fill_frame);
+  if (result == 0) {
+    memory_pattern = UPSET_FILL_PATTERN;
+  }
+  return result;
+}
+
+
+
+int RadmonClient::dump_full()
+{
+  TRACE_SPAN("full dump", "command");
+  last_dump_frame = &full_dump_frame;
+  icount_begin();
+  return send_frame(full_dump_frame);
+}
+
+
+
+int RadmonClient::dump_part()
+{
+  TRACE_SPAN("part dump", "command");
+  last_dump_frame = &part_dump_frame;
+  icount_begin();
+  return send_frame(part_dump_frame);
+}
+
+
+
+int RadmonClient::set_rtc(time_t ts)
+{
+  TRACE_SPAN("set rtc", "command");
+  printf("Current time: %ld\n", ts);
+  sprintf(debug_output, "Current time: %ld", ts);
+  logger.log(debug_output, INFO);
+  return send_frame(encode_rtc_frame(inject_id, ts));
+}
+
+
+
+/* Sets the payload clock so that it ticks over together with the host clock.
+ * The one-way latency is estimated as half the fastest of `probes` round
+ * trips. The RTC frame for the next whole second S is pre-encoded, and sent
+ * at S minus that latency, so it arrives as S begins. The payload clock only
+ * has whole seconds, so the remaining offset is how far the arrival is
+ * estimated to be from that boundary. */
+int RadmonClient::sync_rtc(int probes, RtcSyncResult& result)
+{
+  struct timespec now, send_at, sent;
+  long tx_latency_ns;
+  TRACE_SPAN("sync rtc", "command");
+
+  result = {};
+  result.round_trip = measure_round_trip(probes);
+  if (result.round_trip.count == 0) {
+    logger.log("No round-trip samples, RTC sync assumes zero link latency", WARN);
+  }
+  result.tx_latency_us = result.round_trip.min_us / 2;
+  tx_latency_ns = result.tx_latency_us * 1000;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  result.rtc_value = now.tv_sec + 1;
+  while ((result.rtc_value - now.tv_sec) * 1000000000L - now.tv_nsec - tx_latency_ns < RADMON_RTC_MIN_LEAD_US * 1000L) {
+    result.rtc_value++;
+  }
+  CanusbDataFrame rtc_frame = encode_rtc_frame(inject_id, result.rtc_value);
+
+  long send_ns = result.rtc_value * 1000000000L - tx_latency_ns;
+  send_at.tv_sec = send_ns / 1000000000L;
+  send_at.tv_nsec = send_ns % 1000000000L;
+  while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &send_at, NULL) == EINTR) {
+  }
+
+  clock_gettime(CLOCK_REALTIME, &sent);
+  if (send_frame(rtc_frame) < 0) {
+    return -1;
+  }
+
+  /* Arrival is estimated as send time plus one-way latency; at that moment
+   * the payload reads rtc_value. */
+  double arrival_us = (sent.tv_sec - result.rtc_value) * 1e6 + sent.tv_nsec / 1e3 + result.tx_latency_us;
+  result.offset_us = -arrival_us;
+
+  sprintf(debug_output, "RTC of %03x set to %ld: round trip min %.2f ms (%d probes), TX latency %.2f ms, estimated offset %+.3f ms",
+          inject_id, result.rtc_value, result.round_trip.min_us / 1000, result.round_trip.count,
+          result.tx_latency_us / 1000, result.offset_us / 1000);
+  logger.log(debug_output, INFO);
+  return 0;
+}
+
+
+
+int RadmonClient::receive_frame(unsigned char (&frame_out)[CANUSB_FRAME_BUFFER_SIZE])
+{
+  int frame_len = 0;
+  unsigned char frame[CANUSB_FRAME_BUFFER_SIZE];
+
+  int result, checksum;
+  unsigned char byte;
+
+  int is_frame_complete = 0;
+  char temp_string[4095];
+
+  frame_len = 0;
+  while (!is_frame_complete) {
+    result = reader->read_byte(&byte);
+    if (result == -1) {
+      fprintf(stderr, "read() failed: %s\n", strerror(errno));
+      logger.log("read() failed!", ERROR);
+      return -1;
+      
+    } else if (result > 0) {
+      if (print_traffic) {
+        fprintf(stderr, "%02x ", byte);
+        sprintf(temp_string, "%02x ", byte);
+        strcat(debug_output, temp_string);
+      }
+
+      frame[frame_len++] = byte;
+
+      if (frame_is_complete(frame, frame_len)) {
+        is_frame_complete = 1;
+        break;
+      }
+    } else {
+      return -1;
+    }
+    if (reader->is_empty()) {
+      traced_usleep(2);
+    }
+  }
+  if (print_traffic) {
+    logger.log(debug_output, INFO);
+  }
+
+  if ((frame_len == 20) && (frame[0] == 0xaa) && (frame[1] == 0x55)) {
+    checksum = generate_checksum(&frame[2], 17);
+    if (checksum != frame[frame_len - 1]) {
+      fprintf(stderr, "receive_frame() failed: Checksum incorrect\n");
+      logger.log("receive_frame() failed: Checksum incorrect", ERROR);
+      return -1;
+    }
+  }
+
+  if (frame_len == -1) {
+    printf("Frame recieve error!\n");
+    logger.log("Frame recieve error!", ERROR);
+    return -1;
+  } else {
+    print_frame(frame);
+
+    for (int i=0; i<frame_len; i++) {
+      frame_out[i] = frame[i];
+    }
+  }
+
+  return frame_len;
+}
+
+
+
+int RadmonClient::read_frames_to_file(const char *dump_path, int frame_count)
+{
+  TraceSpan span("dump", "dump");
+  span.arg = frame_count;
+  DurableWriter dump_writer;
+  dump_writer.commit_records = commit_records;
+  dump_writer.commit_ms = commit_ms;
+  if (dump_writer.open(dump_path) == -1) {
+    sprintf(debug_output, "Unable to open dump file %s", dump_path);
+    logger.log(debug_output, ERROR);
+    return -1;
+  }
+
+  int i = 0, next_icount_sample = RADMON_ICOUNT_SAMPLE_FRAMES;
+  int unknown_run_bytes = 0;
+  bool is_abandoned = false;
+  dump_stats.reset(frame_count);
+  dump_slots.reset(frame_count);
+  begin_upset_check(dump_path);
+  if (!is_icount_started) {
+    icount_begin();
+  }
+  while (i < frame_count) {
+    int result = save_frame(dump_writer, i, unknown_run_bytes, i == 0 ? RADMON_DUMP_START_MS : RADMON_DUMP_IDLE_MS);
+    if (is_link_lost) {
+      /* The payload kept streaming while the adapter was away, so the dump
+       * cannot be resumed; it is started over in the same file. */
+      is_link_lost = false;
+      if (recover_link() == -1 || last_dump_frame == nullptr) {
+        is_abandoned = true;
+        break;
+      }
+      logger.log("Re-issuing the interrupted dump", WARN);
+      dump_writer.discard();
+      if (dump_writer.open(dump_path) == -1) {
+        return -1;
+      }
+      i = 0;
+      unknown_run_bytes = 0;
+      next_icount_sample = RADMON_ICOUNT_SAMPLE_FRAMES;
+      dump_stats.reset(frame_count);
+      dump_slots.reset(frame_count);
+      begin_upset_check(dump_path);
+      icount_begin();
+      send_frame(*last_dump_frame);
+      continue;
+    }
+    if (result != 1) {
+      /* The payload has stopped sending; the slots it did not fill are
+       * lost and left to repair_gaps(). */
+      sprintf(debug_output, "Dump ended after %d of %d frames", i, frame_count);
+      logger.log(debug_output, WARN);
+      break;
+    }
+    dump_stats.frames_received.store(i, memory_order_relaxed);
+    if (i >= next_icount_sample) {
+      icount_check(i, dump_stats);
+      next_icount_sample = i + RADMON_ICOUNT_SAMPLE_FRAMES;
+    }
+  }
+  dump_slots.finish();
+  upset_monitor.end();
+
+  /* Frames re-fetched after the dump are merged by writing the file again
+   * from the slot map. */
+  if (!is_abandoned && repair_gaps() > 0) {
+    dump_writer.discard();
+    if (dump_writer.open(dump_path) == -1 || dump_slots.write_to(dump_writer) == -1) {
+      sprintf(debug_output, "Unable to rewrite dump file %s with the re-fetched frames", dump_path);
+      logger.log(debug_output, ERROR);
+      return -1;
+    }
+  }
+
+  /* A dump cut short by a lost adapter never gets the final name; like a
+   * failed rewrite it stays under the temporary one. */
+  if (is_abandoned) {
+    sprintf(debug_output, "Adapter lost after %d of %d frames, dump left as %s%s",
+            i, frame_count, dump_path, DURABLE_TEMP_SUFFIX);
+    logger.log(debug_output, ERROR);
+  } else if (dump_writer.close() == -1) {
+    sprintf(debug_output, "Unable to complete dump file %s, left as %s%s", dump_path, dump_path, DURABLE_TEMP_SUFFIX);
+    logger.log(debug_output, ERROR);
+  }
+  icount_end(i, dump_stats);
+  return is_abandoned ? -1 : 0;
+}
+
+
+
+int RadmonClient::recover_link()
+{
+  if (link == nullptr || link->reconnect() == -1) {
+    return -1;
+  }
+  reader->reset();
+  return 0;
+}
+
+
+
+void RadmonClient::clear_buffer()
+{
+  reader->reset();
+  ::clear_buffer(tty_fd);
+}
+
+
+
+/* Times the send of a part dump to the first byte of its response. The part
+ * dump is the only command that answers without changing payload state. */
+RoundTripStats RadmonClient::measure_round_trip(int probes)
+{
+  RoundTripStats stats = {};
+  vector<double> samples;
+  unsigned char drain[CANUSB_READ_BUFFER_SIZE];
+  struct timespec sent, received;
+
+  for (int p = 0; p < probes; p++) {
+    clear_buffer();
+    clock_gettime(CLOCK_MONOTONIC, &sent);
+    if (send_frame(part_dump_frame) < 0) {
+      break;
+    }
+    if (wait_readable(tty_fd, RADMON_PROBE_TIMEOUT_MS) != 1) {
+      logger.log("Round-trip probe got no response", WARN);
+      continue;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &received);
+    samples.push_back((received.tv_sec - sent.tv_sec) * 1e6 + (received.tv_nsec - sent.tv_nsec) / 1e3);
+
+    while (wait_readable(tty_fd, RADMON_PROBE_IDLE_MS) == 1) {
+      if (read(tty_fd, drain, sizeof(drain)) <= 0) {
+        break;
+      }
+    }
+  }
+
+  if (samples.empty()) {
+    return stats;
+  }
+
+  sort(samples.begin(), samples.end());
+  stats.count = samples.size();
+  stats.min_us = samples.front();
+  stats.median_us = samples[samples.size() / 2];
+  stats.max_us = samples.back();
+  return stats;
+}
+
+
+
+/* Frames are compared with what the last fill or clear left, or with the
+ * pattern given for the monitor when this session sent neither. */
+void RadmonClient::begin_upset_check(const char *dump_path)
+{
+  const char *dump_name = strrchr(dump_path, '/');
+
+  upset_monitor.begin(memory_pattern != UPSET_NO_PATTERN ? memory_pattern : upset_monitor.spec.pattern,
+                      dump_name != nullptr ? dump_name + 1 : dump_path);
+}
+
+
+
+/* Baseline the serial error counters when a dump is requested, so bytes
+ * dropped before read_frames_to_file() starts reading are still counted. */
+void RadmonClient::icount_begin()
+{
+  if (!is_icount_supported) {
+    return;
+  }
+
+  if (adapter_get_icount(tty_fd, &icount_start) == -1) {
+    sprintf(debug_output, "TIOCGICOUNT not supported (%s), serial drops will not be reported", strerror(errno));
+    logger.log(debug_output, INFO);
+    is_icount_supported = false;
+    return;
+  }
+  icount_last = icount_start;
+  is_icount_started = true;
+}
+
+
+
+/* Logs the serial errors since the last sample and stores the totals since
+ * the dump command in stats, which is the group's for a demultiplexed dump. */
+void RadmonClient::icount_check(int frame_index, DumpStats& stats)
+{
+  struct serial_icounter_struct icount;
+
+  if (!is_icount_supported || adapter_get_icount(tty_fd, &icount) == -1) {
+    return;
+  }
+
+  if (icount.overrun != icount_last.overrun || icount.frame != icount_last.frame
+      || icount.parity != icount_last.parity || icount.buf_overrun != icount_last.buf_overrun) {
+    sprintf(debug_output, "Serial errors before frame %d: overrun +%d, framing +%d, parity +%d, buffer overrun +%d",
+            frame_index,
+            icount.overrun - icount_last.overrun,
+            icount.frame - icount_last.frame,
+            icount.parity - icount_last.parity,
+            icount.buf_overrun - icount_last.buf_overrun);
+    logger.log(debug_output, WARN);
+  }
+
+  icount_last = icount;
+  stats.uart_overruns.store(icount.overrun - icount_start.overrun, memory_order_relaxed);
+  stats.framing_errors.store(icount.frame - icount_start.frame, memory_order_relaxed);
+  stats.parity_errors.store(icount.parity - icount_start.parity, memory_order_relaxed);
+  stats.buffer_overruns.store(icount.buf_overrun - icount_start.buf_overrun, memory_order_relaxed);
+}
+
+
+
+/* Takes the last sample and logs the serial errors of the whole dump. */
+void RadmonClient::icount_end(int frame_index, DumpStats& stats)
+{
+  icount_check(frame_index, stats);
+  is_icount_started = false;
+
+  if (is_icount_supported) {
+    sprintf(debug_output, "Serial errors during dump: overrun %d, framing %d, parity %d, buffer overrun %d",
+            icount_last.overrun - icount_start.overrun,
+            icount_last.frame - icount_start.frame,
+            icount_last.parity - icount_start.parity,
+            icount_last.buf_overrun - icount_start.buf_overrun);
+    logger.log(debug_output, icount_last.overrun != icount_start.overrun
+                             || icount_last.buf_overrun != icount_start.buf_overrun ? WARN : INFO);
+  }
+}
+
+
+
+/* Reads one frame and saves it. The slot advances only when a frame arrives:
+ * a data frame, or the first of a run of unknown frames, takes the next one.
+ * Returns 0 when nothing came for timeout_ms, and -1 on a read error. */
+int RadmonClient::save_frame(DurableWriter& dump_writer, int& i, int& unknown_run_bytes, int timeout_ms)
+{
+  int frame_len = 0;
+  unsigned char frame[CANUSB_FRAME_BUFFER_SIZE] = {0x00};
+  int checksum, result;
+
+  result = read_dump_frame(frame, frame_len, timeout_ms, &dump_writer);
+  if (result != 1) {
+    return result;
+  }
+
+  if ((frame_len == 20) && (frame[0] == 0xaa) && (frame[1] == 0x55)) {
+    checksum = generate_checksum(&frame[2], 17);
+    if (checksum != frame[frame_len - 1]) {
+      if (echo_frames) {
+        fprintf(stderr, "receive_frame() failed: Checksum incorrect\n");
+      }
+      logger.log("receive_frame() failed: Checksum incorrect", ERROR);
+      dump_stats.checksum_errors.fetch_add(1, memory_order_relaxed);
+      return 1;
+    }
+  }
+
+  if (frame_len == -1) {
+    printf("Frame recieve error!\n");
+    logger.log("Frame recieve error!", ERROR);
+  } else {
+    if (echo_frames) {
+      print_dump_frame(frame, frame_len);
+    }
+    if (publisher != nullptr) {
+      publisher->publish(frame, frame_len);
+    }
+    char dump_line[DUMP_LINE_SIZE];
+    int dump_line_len;
+    {
+      TRACE_SPAN("format", "dump");
+      dump_line_len = format_dump_frame(dump_line, frame, frame_len);
+    }
+    string_view record(dump_line, dump_line_len);
+    dump_writer.write_record(record);
+    if (is_data_frame(frame, frame_len)) {
+      bool is_intact = is_intact_dump_frame(frame, frame_len);
+      dump_slots.add(i, record, is_intact);
+      if (is_intact) {
+        dump_stats.frames_intact.fetch_add(1, memory_order_relaxed);
+        upset_monitor.check(i, &frame[4]);
+      }
+      i++;
+      unknown_run_bytes = 0;
+    } else {
+      dump_stats.unknown_frames.fetch_add(1, memory_order_relaxed);
+      int run_slots = unknown_run_slots(unknown_run_bytes);
+      unknown_run_bytes += frame_len;
+      i = min(i + unknown_run_slots(unknown_run_bytes) - run_slots, (int)dump_slots.is_intact.size());
+      dump_slots.add(i - 1, record, false);
+    }
+  }
+  return 1;
+}
+
+
+
+/* Reads bytes until a frame is complete (1). An empty read waits up to
+ * timeout_ms for more before giving up (0); with 0 it gives up at once. A
+ * read error is -1, and sets is_link_lost when the adapter has gone. Before
+ * each wait, dump_writer gets its time-based commit if one is due. */
+int RadmonClient::read_dump_frame(unsigned char *frame, int& frame_len, int timeout_ms, DurableWriter *dump_writer)
+{
+  int result;
+  unsigned char byte;
+  char temp_string[4095];
+
+  sprintf(debug_output, " ");
+  frame_len = 0;
+  while (true) {
+    result = reader->read_byte(&byte);
+    if (result == -1 && link != nullptr && is_device_lost(errno)) {
+      is_link_lost = true;
+      return -1;
+
+    } else if (result == 0 || (result == -1 && errno == EAGAIN && timeout_ms > 0)) {
+      if (dump_writer != nullptr) {
+        dump_writer->commit_if_due();
+      }
+      if (timeout_ms > 0 && wait_readable(tty_fd, timeout_ms) == 1) {
+        continue;
+      }
+      return 0;
+
+    } else if (result == -1) {
+      if (echo_frames) {
+        fprintf(stderr, "read() failed: %s\n", strerror(errno));
+      }
+      sprintf(debug_output, "read() failed: %s\n", strerror(errno));
+      logger.log(debug_output, ERROR);
+      dump_stats.read_errors.fetch_add(1, memory_order_relaxed);
+      return -1;
+    }
+
+    dump_stats.bytes_received.fetch_add(1, memory_order_relaxed);
+    if (print_traffic) {
+      fprintf(stderr, "%02x ", byte);
+      sprintf(temp_string, "%02x ", byte);
+      strcat(debug_output, temp_string);
+    }
+
+    frame[frame_len++] = byte;
+    if (frame_is_complete(frame, frame_len)) {
+      return 1;
+    }
+    if (reader->is_empty()) {
+      traced_usleep(2);
+    }
+  }
+}
+
+
+
+/* A data frame that lost or gained bytes on the way still passes
+ * is_data_frame(); its slot only counts as received if the frame is whole
+ * and came from this payload. */
+bool RadmonClient::is_intact_dump_frame(const unsigned char *frame, int frame_len) const
+{
+  return frame_len == RADMON_DUMP_FRAME_BYTES && frame[1] == 0xc8 && frame[12] == 0x55
+         && (frame[2] | (frame[3] << 8)) == receive_id;
+}
+
+
+
+/* Re-requests the slots a dump lost: each gap with a ranged dump where the
+ * payload has one, otherwise only those in the first RADMON_PART_DUMP_FRAMES
+ * with a part dump. It runs once the dump has gone quiet, so nothing the
+ * payload sent is thrown away. Returns how many slots were recovered. */
+int RadmonClient::repair_gaps()
+{
+  vector<pair<int, int>> gaps = dump_slots.gaps(RADMON_GAP_MERGE_FRAMES);
+  int missing = 0, recovered = 0;
+
+  if (gaps.empty()) {
+    return 0;
+  }
+  TRACE_SPAN("repair gaps", "dump");
+  for (auto [first, last] : gaps) {
+    for (int s = first; s < last; s++) {
+      missing += !dump_slots.is_intact[s];
+    }
+  }
+  sprintf(debug_output, "Dump lost %d frames in %zu ranges, first at frame %d", missing, gaps.size(), gaps.front().first);
+  logger.log(debug_output, WARN);
+
+  for (int round = 0; round < RADMON_GAP_RETRIES && !gaps.empty(); round++) {
+    if (is_range_dump_supported) {
+      for (auto [first, last] : gaps) {
+        recovered += refetch_frames(encode_range_dump_frame(inject_id, first, last - first), first, last - first);
+      }
+    } else if (gaps.front().first < RADMON_PART_DUMP_FRAMES) {
+      recovered += refetch_frames(part_dump_frame, 0, RADMON_PART_DUMP_FRAMES);
+    } else {
+      break;
+    }
+    if (is_link_lost) {
+      is_link_lost = false;
+      break;
+    }
+    gaps = dump_slots.gaps(RADMON_GAP_MERGE_FRAMES);
+  }
+
+  sprintf(debug_output, "Re-fetched %d of %d lost frames", recovered, missing);
+  logger.log(debug_output, recovered == missing ? INFO : WARN);
+  return recovered;
+}
+
+
+
+/* Sends request and reads count slots of its response, which start at slot
+ * first of the dump, patching every slot the dump lost. A damaged frame can
+ * fill the last slot before its bytes are all in, so the rest of a damaged
+ * response is let go by before the next request. */
+int RadmonClient::refetch_frames(const CanusbDataFrame& request, int first, int count)
+{
+  TraceSpan span("refetch", "dump");
+  span.arg = count;
+  unsigned char frame[CANUSB_FRAME_BUFFER_SIZE] = {0x00};
+  char dump_line[DUMP_LINE_SIZE];
+  int frame_len, k = 0, recovered = 0;
+  int unknown_run_bytes = 0;
+  bool is_damaged = false;
+
+  if (send_frame(request) < 0) {
+    return 0;
+  }
+  while (k < count && read_dump_frame(frame, frame_len, RADMON_GAP_TIMEOUT_MS) == 1) {
+    if (!is_data_frame(frame, frame_len)) {
+      int run_slots = unknown_run_slots(unknown_run_bytes);
+      unknown_run_bytes += frame_len;
+      k += unknown_run_slots(unknown_run_bytes) - run_slots;
+      is_damaged = true;
+      continue;
+    }
+    if (!is_intact_dump_frame(frame, frame_len)) {
+      is_damaged = true;
+    } else if (!dump_slots.is_intact[first + k]) {
+      dump_slots.patch(first + k, string_view(dump_line, format_dump_frame(dump_line, frame, frame_len)));
+      recovered++;
+    }
+    k++;
+    unknown_run_bytes = 0;
+  }
+  if (is_damaged) {
+    drain_until_quiet();
+  }
+  return recovered;
+}
+
+
+
+/* Discards input until the line has been quiet for RADMON_GAP_QUIET_MS.
+ * clear_buffer() would wait out a whole read timeout in the low-latency
+ * profile instead. */
+void RadmonClient::drain_until_quiet()
+{
+  unsigned char drain[CANUSB_READ_BUFFER_SIZE];
+
+  reader->reset();
+  while (wait_readable(tty_fd, RADMON_GAP_QUIET_MS) == 1 && read(tty_fd, drain, sizeof(drain)) > 0) {
+  }
+}
+
+
+
+void DumpSlots::reset(int frame_count)
+{
+  text.clear();
+  text.reserve(frame_count * DUMP_LINE_SIZE / 2);
+  offsets.assign(frame_count + 1, 0);
+  is_intact.assign(frame_count, false);
+  patches.clear();
+  slots_started = 0;
+}
+
+
+
+/* Slots must be added in order; ones skipped over are left empty. */
+void DumpSlots::add(int slot, string_view record, bool is_intact_frame)
+{
+  while (slots_started <= slot) {
+    offsets[slots_started++] = text.size();
+  }
+  text.append(record);
+  if (is_intact_frame) {
+    is_intact[slot] = true;
+  }
+}
+
+
+
+void DumpSlots::patch(int slot, string_view record)
+{
+  patches[slot] = string(record);
+  is_intact[slot] = true;
+}
+
+
+
+void DumpSlots::finish()
+{
+  while (slots_started < (int)offsets.size()) {
+    offsets[slots_started++] = text.size();
+  }
+}
+
+
+
+/* [first, last) ranges of slots without an intact frame. Ranges less than
+ * merge_frames apart are joined, as one request costs about as much as that
+ * many frames. */
+vector<pair<int, int>> DumpSlots::gaps(int merge_frames) const
+{
+  vector<pair<int, int>> ranges;
+  int slot_count = is_intact.size();
+
+  for (int s = 0; s < slot_count; s++) {
+    if (is_intact[s]) {
+      continue;
+    }
+    if (!ranges.empty() && s - ranges.back().second < merge_frames) {
+      ranges.back().second = s + 1;
+    } else {
+      ranges.push_back({ s, s + 1 });
+    }
+  }
+  return ranges;
+}
+
+
+
+/* Each slot is one record: the patch if it has one, otherwise whatever the
+ * dump wrote for it. */
+int DumpSlots::write_to(DurableWriter& dump_writer) const
+{
+  int slot_count = is_intact.size();
+
+  for (int s = 0; s < slot_count; s++) {
+    auto patched = patches.find(s);
+    int result;
+    if (patched != patches.end()) {
+      result = dump_writer.write_record(patched->second);
+    } else if (offsets[s + 1] > offsets[s]) {
+      result = dump_writer.write_record(string_view(text).substr(offsets[s], offsets[s + 1] - offsets[s]));
+    } else {
+      continue;
+    }
+    if (result == -1) {
+      return -1;
+    }
+  }
+  return 0;
+}
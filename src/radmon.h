@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_RADMON_H
+#define RADMON_RADMON_H
+
+// Includes
+#include <time.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "canusb.h"
+#include "dashboard.h"
+#include "durable_writer.h"
+#include "frame.h"
+#include "frame_publisher.h"
+#include "upset_monitor.h"
+
+// Constants
+#define RADMON_INJECT_ID_DEFAULT 0x010
+#define RADMON_RECEIVE_ID_DEFAULT 0x011
+#define RADMON_FULL_DUMP_FRAMES 8193 /* FRAM (32kB) */
+#define RADMON_PART_DUMP_FRAMES 128  /* FRAM (512B) */
+#define RADMON_ICOUNT_SAMPLE_FRAMES 512 /* frames between serial error counter samples */
+#define RADMON_PROBE_COUNT_DEFAULT 5
+#define RADMON_PROBE_TIMEOUT_MS 1000 /* wait for the first byte of a probe response */
+#define RADMON_PROBE_IDLE_MS 50      /* a probe response has ended after this much silence */
+#define RADMON_RTC_MIN_LEAD_US 5000  /* never aim for a second boundary closer than this */
+#define RADMON_DUMP_FRAME_BYTES 13   /* a dump frame on the serial link */
+#define RADMON_DUMP_START_MS 1000   /* wait for the first frame of a dump */
+#define RADMON_DUMP_IDLE_MS 200      /* a dump has ended after this much silence */
+#define RADMON_GAP_RETRIES 3         /* rounds of re-fetching frames a dump lost */
+#define RADMON_GAP_TIMEOUT_MS 200    /* a re-fetch has ended after this much silence */
+#define RADMON_GAP_MERGE_FRAMES 16   /* gaps closer than this are re-fetched as one range */
+#define RADMON_GAP_QUIET_MS 10       /* the line is quiet once a dump has stopped this long */
+
+#define RADMON_CMD_CLEAR     0x01
+#define RADMON_CMD_FULL_DUMP 0x02
+#define RADMON_CMD_PART_DUMP 0x04
+#define RADMON_CMD_RANGE_DUMP 0x08 /* optional, see is_range_dump_supported */
+#define RADMON_CMD_SET_RTC   0xaa
+#define RADMON_CMD_FILL      0xef
+
+// Inline Definitions
+/* Frames only lose bytes on the way, so a run of unknown frames stands for
+ * as many dump frames as it has started. */
+constexpr int unknown_run_slots(int run_bytes)
+{
+  return (run_bytes + RADMON_DUMP_FRAME_BYTES - 1) / RADMON_DUMP_FRAME_BYTES;
+}
+
+constexpr CanusbDataFrame encode_command_frame(unsigned short inject_id, unsigned char cmd)
+{
+  const unsigned char data[] = { cmd };
+  return encode_data_frame(inject_id, data, 1);
+}
+
+/* The RTC command is the opcode followed by the 32-bit timestamp, big endian. */
+constexpr CanusbDataFrame encode_rtc_frame(unsigned short inject_id, time_t ts)
+{
+  const unsigned char data[] = {
+    RADMON_CMD_SET_RTC,
+    (unsigned char)((ts >> 24) & 0xff),
+    (unsigned char)((ts >> 16) & 0xff),
+    (unsigned char)((ts >> 8) & 0xff),
+    (unsigned char)(ts & 0xff),
+  };
+  return encode_data_frame(inject_id, data, sizeof(data));
+}
+
+/* The ranged dump command is the opcode followed by the first frame and the
+ * frame count, both 16-bit big endian. */
+constexpr CanusbDataFrame encode_range_dump_frame(unsigned short inject_id, int first, int count)
+{
+  const unsigned char data[] = {
+    RADMON_CMD_RANGE_DUMP,
+    (unsigned char)((first >> 8) & 0xff),
+    (unsigned char)(first & 0xff),
+    (unsigned char)((count >> 8) & 0xff),
+    (unsigned char)(count & 0xff),
+  };
+  return encode_data_frame(inject_id, data, sizeof(data));
+}
+
+// Type Definitions
+/* The text of a dump by frame slot, so that slots which lost their frame can
+ * be fetched again and patched in. Slots are counted the way save_frame()
+ * counts frames: a run of unknown frames takes the slots of the frames it
+ * replaced, one per RADMON_DUMP_FRAME_BYTES bytes or part of them, and slots
+ * after the dump went silent are left empty. */
+struct DumpSlots {
+  std::string text;                   /* every record, in order */
+  std::vector<int> offsets;           /* start of each slot in text, frame_count + 1 */
+  std::vector<bool> is_intact;        /* slot holds a well-formed data frame */
+  std::map<int, std::string> patches; /* re-fetched records by slot */
+  int slots_started = 0;
+
+  void reset(int frame_count);
+  void add(int slot, std::string_view record, bool is_intact_frame);
+  void patch(int slot, std::string_view record);
+  void finish();
+  std::vector<std::pair<int, int>> gaps(int merge_frames) const;
+  int write_to(DurableWriter& dump_writer) const;
+};
+
+struct RoundTripStats {
+  int count;        /* probes that got a response */
+  double min_us;
+  double median_us;
+  double max_us;
+};
+
+struct RtcSyncResult {
+  time_t rtc_value;      /* the second the payload clock was set to */
+  RoundTripStats round_trip;
+  double tx_latency_us;  /* estimated one-way latency, half the fastest round trip */
+  double offset_us;      /* estimated payload clock minus host clock after sync */
+};
+
+class RadmonClient {
+  public:
+    int tty_fd;
+    unsigned short inject_id;
+    unsigned short receive_id;
+    bool echo_frames = false; /* print every dump frame to stdout */
+    int commit_records = DURABLE_COMMIT_RECORDS_DEFAULT; /* dump group commit */
+    int commit_ms = DURABLE_COMMIT_MS_DEFAULT;
+    DumpStats dump_stats;
+    FramePublisher *publisher = nullptr; /* live fan-out of dump frames, optional */
+    AdapterLink *link = nullptr; /* reconnects a lost adapter when set */
+    bool is_range_dump_supported = false; /* payload answers RADMON_CMD_RANGE_DUMP */
+    UpsetMonitor upset_monitor; /* checks dump frames as they arrive when enabled */
+    std::shared_ptr<SerialReader> reader; /* shared by every client on the same tty */
+
+    RadmonClient(int tty_fd, unsigned short inject_id = RADMON_INJECT_ID_DEFAULT,
+                 unsigned short receive_id = RADMON_RECEIVE_ID_DEFAULT);
+    RadmonClient(std::shared_ptr<SerialReader> reader, unsigned short inject_id,
+                 unsigned short receive_id);
+    int clear();
+    int fill();
+    int dump_full();
+    int dump_part();
+    int set_rtc(time_t ts);
+    int sync_rtc(int probes, RtcSyncResult& result);
+    int receive_frame(unsigned char (&frame_out)[CANUSB_FRAME_BUFFER_SIZE]);
+    int read_frames_to_file(const char *dump_path, int frame_count);
+    void clear_buffer();
+    RoundTripStats measure_round_trip(int probes);
+    void begin_upset_check(const char *dump_path);
+    bool is_intact_dump_frame(const unsigned char *frame, int frame_len) const;
+    void icount_check(int frame_index, DumpStats& stats);
+    void icount_end(int frame_index, DumpStats& stats);
+
+  private:
+    CanusbDataFrame clear_frame;
+    CanusbDataFrame fill_frame;
+    CanusbDataFrame full_dump_frame;
+    CanusbDataFrame part_dump_frame;
+    struct serial_icounter_struct icount_start = {};
+    struct serial_icounter_struct icount_last = {};
+    bool is_icount_supported = true;
+    bool is_icount_started = false;
+    const CanusbDataFrame *last_dump_frame = nullptr; /* re-issued after a reconnect */
+    bool is_link_lost = false;
+    DumpSlots dump_slots;
+    int memory_pattern = UPSET_NO_PATTERN; /* left by the last fill or clear of this session */
+
+    int send_frame(const CanusbDataFrame& frame);
+    int recover_link();
+    int read_dump_frame(unsigned char *frame, int& frame_len, int timeout_ms, DurableWriter *dump_writer = nullptr);
+    int repair_gaps();
+    int refetch_frames(const CanusbDataFrame& request, int first, int count);
+    void drain_until_quiet();
+    int save_frame(DurableWriter& dump_writer, int& i, int& unknown_run_bytes, int timeout_ms);
+    void icount_begin();
+};
+
+#endif
@@ -0,0 +1,402 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "logger.h"
+#include "radmon_group.h"
+#include "tracer.h"
+
+using namespace std;
+
+
+
+// Function Definitions
+RadmonGroup::RadmonGroup(int tty_fd)
+  : tty_fd(tty_fd), reader(make_shared<SerialReader>(tty_fd))
+{
+}
+
+
+
+void RadmonGroup::add_payload(unsigned short inject_id, unsigned short receive_id)
+{
+  payloads.push_back(make_unique<RadmonClient>(reader, inject_id, receive_id));
+  sprintf(debug_output, "Payload %zu: inject ID %03x, receive ID %03x", payloads.size(), inject_id, receive_id);
+  logger.log(debug_output, INFO);
+}
+
+
+
+void RadmonGroup::set_echo_frames(bool echo_frames)
+{
+  for (auto& payload : payloads) {
+    payload->echo_frames = echo_frames;
+  }
+}
+
+
+
+bool RadmonGroup::echo_frames() const
+{
+  return !payloads.empty() && payloads[0]->echo_frames;
+}
+
+
+
+/* Every parsed frame is published, including data frames from IDs no
+ * payload owns; subscribers filter by ID themselves. */
+void RadmonGroup::set_publisher(FramePublisher *publisher)
+{
+  this->publisher = publisher;
+  for (auto& payload : payloads) {
+    payload->publisher = publisher;
+  }
+}
+
+
+
+/* Commands from any payload reconnect through the shared link. */
+void RadmonGroup::set_link(AdapterLink *link)
+{
+  this->link = link;
+  for (auto& payload : payloads) {
+    payload->link = link;
+  }
+}
+
+
+
+/* Lost frames of a single-payload dump are re-fetched; demultiplexed dumps
+ * are not. */
+void RadmonGroup::set_range_dump_supported(bool is_supported)
+{
+  for (auto& payload : payloads) {
+    payload->is_range_dump_supported = is_supported;
+  }
+}
+
+
+
+/* Every payload keeps its own counts, alerts and expected pattern. */
+void RadmonGroup::set_upset_spec(const UpsetSpec& spec)
+{
+  for (auto& payload : payloads) {
+    payload->upset_monitor.spec = spec;
+    payload->upset_monitor.is_enabled = true;
+  }
+}
+
+
+
+int RadmonGroup::clear()
+{
+  int result = 0;
+  for (auto& payload : payloads) {
+    result |= payload->clear();
+  }
+  return result;
+}
+
+
+
+int RadmonGroup::fill()
+{
+  int result = 0;
+  for (auto& payload : payloads) {
+    result |= payload->fill();
+  }
+  return result;
+}
+
+
+
+int RadmonGroup::dump_full()
+{
+  int result = 0;
+  is_last_dump_part = false;
+  for (auto& payload : payloads) {
+    result |= payload->dump_full();
+  }
+  return result;
+}
+
+
+
+int RadmonGroup::dump_part()
+{
+  int result = 0;
+  is_last_dump_part = true;
+  for (auto& payload : payloads) {
+    result |= payload->dump_part();
+  }
+  return result;
+}
+
+
+
+int RadmonGroup::set_rtc(time_t ts)
+{
+  int result = 0;
+  for (auto& payload : payloads) {
+    result |= payload->set_rtc(ts);
+  }
+  return result;
+}
+
+
+
+/* Synchronised one payload at a time, as each waits for a second boundary. */
+int RadmonGroup::sync_rtc(int probes)
+{
+  RtcSyncResult result;
+  int status = 0;
+
+  for (auto& payload : payloads) {
+    if (payload->sync_rtc(probes, result) == -1) {
+      status = -1;
+      continue;
+    }
+    fprintf(stderr, "RTC of %03x set to %ld, TX latency %.2f ms, estimated offset %+.3f ms.\n",
+            payload->inject_id, result.rtc_value, result.tx_latency_us / 1000, result.offset_us / 1000);
+  }
+  return status;
+}
+
+
+
+/* Clear and fill each answer with a single frame. */
+int RadmonGroup::receive_responses()
+{
+  unsigned char frame[CANUSB_FRAME_BUFFER_SIZE];
+  int result = 0;
+
+  for (auto& payload : payloads) {
+    if (payload->receive_frame(frame) == -1) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+
+
+int RadmonGroup::read_frames_to_files(const vector<string>& dump_paths, int frame_count)
+{
+  if (payloads.size() == 1) {
+    return payloads[0]->read_frames_to_file(dump_paths[0].c_str(), frame_count);
+  }
+  return demux_frames_to_files(dump_paths, frame_count);
+}
+
+
+
+void RadmonGroup::clear_buffer()
+{
+  payloads[0]->clear_buffer();
+}
+
+
+
+void RadmonGroup::set_commit_policy(int commit_records, int commit_ms)
+{
+  this->commit_records = commit_records;
+  this->commit_ms = commit_ms;
+  for (auto& payload : payloads) {
+    payload->commit_records = commit_records;
+    payload->commit_ms = commit_ms;
+  }
+}
+
+
+
+RoundTripStats RadmonGroup::measure_round_trip(int probes)
+{
+  return payloads[0]->measure_round_trip(probes);
+}
+
+
+
+const DumpStats& RadmonGroup::stats() const
+{
+  if (payloads.size() == 1) {
+    return payloads[0]->dump_stats;
+  }
+  return dump_stats;
+}
+
+
+
+/* Reads the interleaved responses of every payload until each has sent
+ * frame_count data frames or the bus has been idle for RADMON_GROUP_IDLE_MS.
+ * Frames are routed by receive ID. An unknown frame has no ID, so it goes to
+ * the file of the payload whose frame came just before it, as a best guess;
+ * data frames from other IDs are counted and logged. Serial errors are
+ * sampled through the first payload, which shares the tty with the rest. */
+int RadmonGroup::demux_frames_to_files(const vector<string>& dump_paths, int frame_count)
+{
+  int payload_count = payloads.size();
+  vector<DurableWriter> dump_writers(payload_count);
+  char dump_line[DUMP_LINE_SIZE];
+  vector<int> frames_saved(payload_count, 0);
+  int payloads_done = 0, unmatched_frames = 0;
+  unsigned char frame[CANUSB_FRAME_BUFFER_SIZE] = {0x00};
+  int frame_len = 0, result, total_frames = 0;
+  int last_k = 0, next_icount_sample = RADMON_ICOUNT_SAMPLE_FRAMES;
+  bool is_abandoned = false;
+  unsigned char byte;
+  TraceSpan span("demux dump", "dump");
+  span.arg = frame_count * payload_count;
+
+  for (int k = 0; k < payload_count; k++) {
+    dump_writers[k].commit_records = commit_records;
+    dump_writers[k].commit_ms = commit_ms;
+    if (dump_writers[k].open(dump_paths[k].c_str()) == -1) {
+      sprintf(debug_output, "Unable to open dump file %s", dump_paths[k].c_str());
+      logger.log(debug_output, ERROR);
+      return -1;
+    }
+    payloads[k]->begin_upset_check(dump_paths[k].c_str());
+  }
+
+  dump_stats.reset(frame_count * payload_count);
+  while (payloads_done < payload_count) {
+    result = reader->read_byte(&byte);
+    if (result <= 0) {
+      if (result == -1 && link != nullptr && is_device_lost(errno)) {
+        /* Interleaved dumps cannot be resumed either; start them all over. */
+        if (link->reconnect() == -1) {
+          dump_stats.read_errors.fetch_add(1, memory_order_relaxed);
+          is_abandoned = true;
+          break;
+        }
+        reader->reset();
+        logger.log("Re-issuing the interrupted dumps", WARN);
+        for (int k = 0; k < payload_count; k++) {
+          dump_writers[k].discard();
+          if (dump_writers[k].open(dump_paths[k].c_str()) == -1) {
+            return -1;
+          }
+          frames_saved[k] = 0;
+          payloads[k]->begin_upset_check(dump_paths[k].c_str());
+        }
+        payloads_done = unmatched_frames = total_frames = frame_len = last_k = 0;
+        next_icount_sample = RADMON_ICOUNT_SAMPLE_FRAMES;
+        dump_stats.reset(frame_count * payload_count);
+        if (is_last_dump_part) {
+          dump_part();
+        } else {
+          dump_full();
+        }
+        continue;
+      }
+      if (result == -1 && errno != EAGAIN) {
+        sprintf(debug_output, "read() failed: %s", strerror(errno));
+        logger.log(debug_output, ERROR);
+        dump_stats.read_errors.fetch_add(1, memory_order_relaxed);
+        break;
+      }
+      for (auto& dump_writer : dump_writers) {
+        dump_writer.commit_if_due();
+      }
+      if (wait_readable(tty_fd, RADMON_GROUP_IDLE_MS) == 0) {
+        logger.log("Bus idle before every payload finished its dump", WARN);
+        break;
+      }
+      continue;
+    }
+
+    dump_stats.bytes_received.fetch_add(1, memory_order_relaxed);
+    frame[frame_len++] = byte;
+    if (!frame_is_complete(frame, frame_len)) {
+      continue;
+    }
+
+    if (is_data_frame(frame, frame_len)) {
+      if (publisher != nullptr) {
+        publisher->publish(frame, frame_len);
+      }
+      unsigned short id = (frame[3] << 8) | frame[2];
+      int k = 0;
+      while (k < payload_count && payloads[k]->receive_id != id) {
+        k++;
+      }
+      if (k < payload_count && frames_saved[k] < frame_count) {
+        if (payloads[k]->echo_frames) {
+          print_dump_frame(frame, frame_len);
+        }
+        int dump_line_len = format_dump_frame(dump_line, frame, frame_len);
+        dump_writers[k].write_record(string_view(dump_line, dump_line_len));
+        if (payloads[k]->is_intact_dump_frame(frame, frame_len)) {
+          dump_stats.frames_intact.fetch_add(1, memory_order_relaxed);
+          payloads[k]->upset_monitor.check(frames_saved[k], &frame[4]);
+        }
+        if (++frames_saved[k] == frame_count) {
+          payloads_done++;
+        }
+        last_k = k;
+        dump_stats.frames_received.store(++total_frames, memory_order_relaxed);
+        if (total_frames >= next_icount_sample) {
+          payloads[0]->icount_check(total_frames, dump_stats);
+          next_icount_sample = total_frames + RADMON_ICOUNT_SAMPLE_FRAMES;
+        }
+      } else {
+        unmatched_frames++;
+      }
+    } else if ((frame_len == 20) && (frame[1] == 0x55)
+               && (generate_checksum(&frame[2], 17) != frame[frame_len - 1])) {
+      dump_stats.checksum_errors.fetch_add(1, memory_order_relaxed);
+    } else {
+      if (payloads[last_k]->echo_frames) {
+        print_dump_frame(frame, frame_len);
+      }
+      if (publisher != nullptr) {
+        publisher->publish(frame, frame_len);
+      }
+      int dump_line_len = format_dump_frame(dump_line, frame, frame_len);
+      dump_writers[last_k].write_record(string_view(dump_line, dump_line_len));
+      dump_stats.unknown_frames.fetch_add(1, memory_order_relaxed);
+    }
+
+    memset(frame, 0x00, sizeof(frame));
+    frame_len = 0;
+  }
+
+  for (int k = 0; k < payload_count; k++) {
+    payloads[k]->upset_monitor.end();
+    if (is_abandoned) {
+      sprintf(debug_output, "Adapter lost, dump left as %s%s", dump_paths[k].c_str(), DURABLE_TEMP_SUFFIX);
+      logger.log(debug_output, ERROR);
+    } else if (dump_writers[k].close() == -1) {
+      sprintf(debug_output, "Unable to complete dump file %s", dump_paths[k].c_str());
+      logger.log(debug_output, ERROR);
+    }
+    sprintf(debug_output, "Payload %03x: %d/%d frames saved to %s",
+            payloads[k]->receive_id, frames_saved[k], frame_count, dump_paths[k].c_str());
+    logger.log(debug_output, frames_saved[k] == frame_count ? INFO : WARN);
+  }
+  payloads[0]->icount_end(total_frames, dump_stats);
+  if (unmatched_frames > 0) {
+    sprintf(debug_output, "%d data frames from unknown or finished IDs dropped", unmatched_frames);
+    logger.log(debug_output, WARN);
+  }
+
+  return payloads_done == payload_count ? 0 : -1;
+}
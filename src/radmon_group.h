@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_RADMON_GROUP_H
+#define RADMON_RADMON_GROUP_H
+
+// Includes
+#include <time.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dashboard.h"
+#include "radmon.h"
+
+// Constants
+#define RADMON_GROUP_IDLE_MS 2000 /* a demultiplexed dump ends after this much bus silence */
+
+// Type Definitions
+/* Several radmon payloads behind one adapter. Commands go out to every
+ * payload back-to-back, and interleaved dump responses are split by receive
+ * ID into one dump stream per payload. With a single payload every call is
+ * passed straight through to its RadmonClient. */
+class RadmonGroup {
+  public:
+    int tty_fd;
+    std::shared_ptr<SerialReader> reader;
+    std::vector<std::unique_ptr<RadmonClient>> payloads;
+    DumpStats dump_stats;
+    FramePublisher *publisher = nullptr;
+    AdapterLink *link = nullptr;
+    int commit_records = DURABLE_COMMIT_RECORDS_DEFAULT;
+    int commit_ms = DURABLE_COMMIT_MS_DEFAULT;
+
+    RadmonGroup(int tty_fd);
+    void add_payload(unsigned short inject_id, unsigned short receive_id);
+    void set_echo_frames(bool echo_frames);
+    bool echo_frames() const;
+    void set_publisher(FramePublisher *publisher);
+    void set_link(AdapterLink *link);
+    void set_range_dump_supported(bool is_supported);
+    void set_upset_spec(const UpsetSpec& spec);
+    int clear();
+    int fill();
+    int dump_full();
+    int dump_part();
+    int set_rtc(time_t ts);
+    int sync_rtc(int probes);
+    int receive_responses();
+    int read_frames_to_files(const std::vector<std::string>& dump_paths, int frame_count);
+    void clear_buffer();
+    void set_commit_policy(int commit_records, int commit_ms);
+    RoundTripStats measure_round_trip(int probes);
+    const DumpStats& stats() const;
+
+  private:
+    bool is_last_dump_part = false; /* which dump to re-issue after a reconnect */
+
+    int demux_frames_to_files(const std::vector<std::string>& dump_paths, int frame_count);
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "logger.h"
+#include "realtime.h"
+
+using namespace std;
+
+
+
+// Global Variables
+/* What the process started with, saved before the I/O thread changes it, so
+ * helper threads go back to the user's taskset and policy, not to every CPU. */
+static bool is_pinned = false;
+static cpu_set_t original_cpu_set;
+static bool is_fifo = false;
+static int original_policy = SCHED_OTHER;
+static struct sched_param original_param = {};
+
+
+
+// Function Definitions
+int pin_thread_to_cpu(int cpu)
+{
+  cpu_set_t cpu_set;
+  int result;
+
+  if (!is_pinned && pthread_getaffinity_np(pthread_self(), sizeof(original_cpu_set), &original_cpu_set) != 0) {
+    fprintf(stderr, "Unable to read the CPU affinity, not pinning.\n");
+    logger.log("Unable to read the CPU affinity, not pinning", ERROR);
+    return -1;
+  }
+
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  if (result != 0) {
+    fprintf(stderr, "Unable to pin thread to CPU %d: %s\n", cpu, strerror(result));
+    sprintf(debug_output, "Unable to pin thread to CPU %d: %s", cpu, strerror(result));
+    logger.log(debug_output, ERROR);
+    return -1;
+  }
+
+  is_pinned = true;
+  sprintf(debug_output, "I/O thread pinned to CPU %d", cpu);
+  logger.log(debug_output, INFO);
+  return 0;
+}
+
+
+
+int set_thread_fifo(int priority)
+{
+  struct sched_param param = {};
+  int result;
+
+  if (!is_fifo) {
+    pthread_getschedparam(pthread_self(), &original_policy, &original_param);
+  }
+  param.sched_priority = priority;
+  result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  if (result != 0) {
+    fprintf(stderr, "Unable to set SCHED_FIFO priority %d: %s\n", priority, strerror(result));
+    sprintf(debug_output, "Unable to set SCHED_FIFO priority %d: %s", priority, strerror(result));
+    logger.log(debug_output, ERROR);
+    return -1;
+  }
+
+  is_fifo = true;
+  sprintf(debug_output, "I/O thread running SCHED_FIFO at priority %d", priority);
+  logger.log(debug_output, INFO);
+  return 0;
+}
+
+
+
+/* New threads inherit the creator's CPU pin and SCHED_FIFO policy. Helper
+ * threads call this so they never compete with the I/O thread; it only undoes
+ * what pin_thread_to_cpu() and set_thread_fifo() changed. */
+void release_thread_realtime()
+{
+  if (is_fifo) {
+    pthread_setschedparam(pthread_self(), original_policy, &original_param);
+  }
+  if (is_pinned) {
+    pthread_setaffinity_np(pthread_self(), sizeof(original_cpu_set), &original_cpu_set);
+  }
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "frame.h"
+#include "logger.h"
+#include "realtime.h"
+#include "selftest.h"
+#include "tracer.h"
+
+using namespace std;
+
+
+
+// Function Prototypes
+static long monotonic_ns();
+static unsigned int selftest_check_word(unsigned int seq);
+static void receive_echoes(int tty_fd, unsigned int seq_base, vector<long>& echo_ns, SelfTestStep& step,
+                           const atomic<long>& stop_at_ns);
+static double percentile(const vector<double>& sorted, double p);
+
+
+
+// Function Definitions
+/* Puts the adapter into the given loopback mode and streams numbered frames
+ * at rising rates until one step loses, corrupts or fails to send a frame.
+ * The adapter is returned to CANUSB_MODE_NORMAL afterwards. */
+int run_loopback_selftest(int tty_fd, CANUSB_SPEED speed, CANUSB_MODE mode, SelfTestReport& report)
+{
+  report = {};
+  report.max_loss_free_step = -1;
+
+  if (command_settings(tty_fd, speed, mode, CANUSB_FRAME_STANDARD) < 0) {
+    return -1;
+  }
+  usleep(100000);
+  clear_buffer(tty_fd);
+
+  unsigned int seq_base = 0;
+  for (double rate = SELFTEST_START_RATE; rate <= SELFTEST_MAX_RATE; rate *= SELFTEST_RATE_STEP) {
+    SelfTestStep step;
+    if (run_loopback_step(tty_fd, (int)rate, SELFTEST_STEP_MS, seq_base, step) < 0) {
+      break;
+    }
+    seq_base += step.sent + step.send_errors;
+    report.steps.push_back(step);
+
+    sprintf(debug_output, "Loopback %d frames/s: sent %d (%.0f/s), received %d, lost %d, corrupt %d, p99 %.0f us",
+            step.target_rate, step.sent, step.sent_rate, step.received, step.lost, step.corrupt, step.latency_p99_us);
+    logger.log(debug_output, (step.lost || step.corrupt || step.send_errors) ? WARN : INFO);
+
+    if (step.lost || step.corrupt || step.send_errors) {
+      break;
+    }
+    report.max_loss_free_step = report.steps.size() - 1;
+  }
+
+  command_settings(tty_fd, speed, CANUSB_MODE_NORMAL, CANUSB_FRAME_STANDARD);
+  return 0;
+}
+
+
+
+/* Frame k of a step carries seq_base + k and a check word derived from it,
+ * so any echo can be matched to its send time and verified on its own. A
+ * reader thread collects echoes while this thread paces the sends on an
+ * absolute schedule. */
+int run_loopback_step(int tty_fd, int rate, int duration_ms, unsigned int seq_base, SelfTestStep& step)
+{
+  int frame_count = max(1, (int)((long)rate * duration_ms / 1000));
+  long period_ns = 1000000000L / rate;
+  vector<long> send_ns(frame_count, -1);
+  vector<long> echo_ns(frame_count, -1);
+  atomic<long> stop_at_ns(0);
+  struct timespec send_at;
+  long first_ns = 0, last_ns = 0;
+
+  step = {};
+  step.target_rate = rate;
+
+  thread receiver(receive_echoes, tty_fd, seq_base, ref(echo_ns), ref(step), cref(stop_at_ns));
+
+  long start_ns = monotonic_ns();
+  for (int k = 0; k < frame_count; k++) {
+    long due_ns = start_ns + k * period_ns;
+    send_at.tv_sec = due_ns / 1000000000L;
+    send_at.tv_nsec = due_ns % 1000000000L;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &send_at, NULL) == EINTR) {
+    }
+
+    unsigned int seq = seq_base + k;
+    unsigned int check = selftest_check_word(seq);
+    unsigned char data[8] = {
+      (unsigned char)(seq >> 24), (unsigned char)(seq >> 16), (unsigned char)(seq >> 8), (unsigned char)seq,
+      (unsigned char)(check >> 24), (unsigned char)(check >> 16), (unsigned char)(check >> 8), (unsigned char)check,
+    };
+    CanusbDataFrame frame = encode_data_frame(SELFTEST_CAN_ID, data, sizeof(data));
+
+    send_ns[k] = monotonic_ns();
+    if (frame_send(tty_fd, frame.bytes, frame.len) < 0) {
+      send_ns[k] = -1;
+      step.send_errors++;
+      continue;
+    }
+    if (step.sent == 0) {
+      first_ns = send_ns[k];
+    }
+    last_ns = send_ns[k];
+    step.sent++;
+  }
+
+  stop_at_ns.store(monotonic_ns() + SELFTEST_DRAIN_MS * 1000000L, memory_order_release);
+  receiver.join();
+
+  if (step.sent > 1) {
+    step.sent_rate = (step.sent - 1) * 1e9 / (last_ns - first_ns);
+  }
+
+  vector<double> latencies;
+  latencies.reserve(frame_count);
+  for (int k = 0; k < frame_count; k++) {
+    if (send_ns[k] == -1) {
+      continue;
+    }
+    if (echo_ns[k] == -1) {
+      step.lost++;
+    } else {
+      latencies.push_back((echo_ns[k] - send_ns[k]) / 1e3);
+    }
+  }
+  sort(latencies.begin(), latencies.end());
+  step.latency_p50_us = percentile(latencies, 0.50);
+  step.latency_p90_us = percentile(latencies, 0.90);
+  step.latency_p99_us = percentile(latencies, 0.99);
+  step.latency_max_us = latencies.empty() ? 0 : latencies.back();
+  return 0;
+}
+
+
+
+void print_selftest_report(const SelfTestReport& report)
+{
+  printf("%8s %9s %7s %7s %5s %7s %9s %9s %9s %9s\n",
+         "target/s", "sent/s", "sent", "echoed", "lost", "corrupt", "p50 us", "p90 us", "p99 us", "max us");
+  for (const SelfTestStep& step : report.steps) {
+    printf("%8d %9.0f %7d %7d %5d %7d %9.0f %9.0f %9.0f %9.0f%s\n",
+           step.target_rate, step.sent_rate, step.sent, step.received, step.lost + step.send_errors, step.corrupt,
+           step.latency_p50_us, step.latency_p90_us, step.latency_p99_us, step.latency_max_us,
+           step.send_errors ? "  (write failed)" : "");
+  }
+
+  if (report.max_loss_free_step == -1) {
+    printf("No loss-free rate: frames were lost at %d frames/s.\n", SELFTEST_START_RATE);
+  } else {
+    const SelfTestStep& best = report.steps[report.max_loss_free_step];
+    printf("Maximum loss-free rate: %.0f frames/s (latency p50 %.0f us, p99 %.0f us, max %.0f us)\n",
+           best.sent_rate, best.latency_p50_us, best.latency_p99_us, best.latency_max_us);
+  }
+}
+
+
+
+static long monotonic_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+
+
+static unsigned int selftest_check_word(unsigned int seq)
+{
+  return (seq * 0x9e3779b1u) ^ 0xa5c3f00fu;
+}
+
+
+
+/* Runs until every frame of the step is echoed or stop_at_ns passes. Echoes
+ * whose sequence number falls outside this step are late arrivals from the
+ * previous one and are skipped. */
+static void receive_echoes(int tty_fd, unsigned int seq_base, vector<long>& echo_ns, SelfTestStep& step,
+                           const atomic<long>& stop_at_ns)
+{
+  SerialReader reader(tty_fd);
+  unsigned char frame[CANUSB_FRAME_BUFFER_SIZE];
+  unsigned char byte;
+  int frame_len = 0, result;
+  int frame_count = echo_ns.size();
+  char message[128];
+
+  release_thread_realtime();
+  trace_thread_name("loopback receiver");
+  while (step.received < frame_count) {
+    long stop_ns = stop_at_ns.load(memory_order_acquire);
+    if (stop_ns != 0 && monotonic_ns() > stop_ns) {
+      break;
+    }
+
+    result = reader.read_byte(&byte);
+    if (result <= 0) {
+      if (result == -1 && errno != EAGAIN) {
+        snprintf(message, sizeof(message), "Loopback read() failed: %s", strerror(errno));
+        logger.log(message, ERROR);
+        break;
+      }
+      wait_readable(tty_fd, 10);
+      continue;
+    }
+
+    frame[frame_len++] = byte;
+    if (!frame_is_complete(frame, frame_len)) {
+      continue;
+    }
+    if (frame_len != 13 || frame[1] != 0xc8 || frame[12] != 0x55 ||
+        (frame[2] | (frame[3] << 8)) != SELFTEST_CAN_ID) {
+      if (frame[0] == 0xaa) {
+        step.corrupt++;
+      }
+      frame_len = 0;
+      continue;
+    }
+    frame_len = 0;
+
+    unsigned int seq = (frame[4] << 24) | (frame[5] << 16) | (frame[6] << 8) | frame[7];
+    unsigned int check = (frame[8] << 24) | (frame[9] << 16) | (frame[10] << 8) | frame[11];
+    if (check != selftest_check_word(seq)) {
+      step.corrupt++;
+      continue;
+    }
+    if (seq - seq_base >= (unsigned int)frame_count) {
+      continue;
+    }
+    if (echo_ns[seq - seq_base] != -1) {
+      step.duplicate++;
+      continue;
+    }
+    echo_ns[seq - seq_base] = monotonic_ns();
+    step.received++;
+  }
+}
+
+
+
+static double percentile(const vector<double>& sorted, double p)
+{
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_SELFTEST_H
+#define RADMON_SELFTEST_H
+
+// Includes
+#include <vector>
+
+#include "canusb.h"
+
+// Constants
+#define SELFTEST_CAN_ID 0x7ff
+#define SELFTEST_START_RATE 100    /* frames/s */
+#define SELFTEST_MAX_RATE 20000    /* frames/s */
+#define SELFTEST_RATE_STEP 1.5
+#define SELFTEST_STEP_MS 1000
+#define SELFTEST_DRAIN_MS 500      /* echoes later than this after a step are lost */
+
+// Type Definitions
+/* One fixed-rate burst of loopback frames. Latencies are send to echo. */
+struct SelfTestStep {
+  int target_rate;     /* frames/s */
+  double sent_rate;    /* frames/s actually written */
+  int sent;
+  int send_errors;
+  int received;
+  int lost;
+  int corrupt;
+  int duplicate;
+  double latency_p50_us;
+  double latency_p90_us;
+  double latency_p99_us;
+  double latency_max_us;
+};
+
+struct SelfTestReport {
+  std::vector<SelfTestStep> steps;
+  int max_loss_free_step; /* index into steps, -1 if even the first step lost frames */
+};
+
+// Function Prototypes
+int run_loopback_selftest(int tty_fd, CANUSB_SPEED speed, CANUSB_MODE mode, SelfTestReport& report);
+int run_loopback_step(int tty_fd, int rate, int duration_ms, unsigned int seq_base, SelfTestStep& step);
+void print_selftest_report(const SelfTestReport& report);
+
+#endif
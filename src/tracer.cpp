@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tracer.h"
+
+using namespace std;
+
+// Type Definitions
+struct TraceEvent {
+  const char *name;
+  const char *category;
+  long start_ns;
+  long duration_ns;
+  long arg;
+};
+
+/* Each thread appends to its own buffer without locking; the registry lock
+ * is only taken when a thread records its first event. */
+struct TraceThread {
+  int tid;
+  const char *name = nullptr;
+  long dropped = 0;
+  vector<TraceEvent> events;
+};
+
+// Global Variables
+bool trace_enabled = false;
+static string trace_path;
+static long trace_origin_ns = 0;
+static mutex trace_threads_mutex;
+static vector<shared_ptr<TraceThread>> trace_threads;
+static thread_local shared_ptr<TraceThread> current_thread;
+
+
+// Function Prototypes
+static TraceThread& this_thread_buffer();
+static void trace_write();
+
+
+
+// Function Definitions
+/* Enables tracing and writes the trace to trace_path when the program exits.
+ * Must be called before any other thread is started. */
+int trace_start(const char *trace_path)
+{
+  FILE *trace_file = fopen(trace_path, "w");
+  if (trace_file == NULL) {
+    fprintf(stderr, "fopen(%s) failed: %s\n", trace_path, strerror(errno));
+    return -1;
+  }
+  fclose(trace_file);
+
+  ::trace_path = trace_path;
+  trace_origin_ns = trace_now_ns();
+  trace_enabled = true;
+  trace_thread_name("main");
+  atexit(trace_write);
+  return 0;
+}
+
+
+
+void trace_record(const char *name, const char *category, long start_ns, long end_ns, long arg)
+{
+  TraceThread& thread = this_thread_buffer();
+  if (thread.events.size() >= TRACE_MAX_EVENTS_PER_THREAD) {
+    thread.dropped++;
+    return;
+  }
+  thread.events.push_back({ name, category, start_ns, end_ns - start_ns, arg });
+}
+
+
+
+void trace_thread_name(const char *name)
+{
+  if (trace_enabled) {
+    this_thread_buffer().name = name;
+  }
+}
+
+
+
+void traced_usleep(useconds_t usec)
+{
+  TraceSpan span("usleep", "wait");
+  span.arg = usec;
+  usleep(usec);
+}
+
+
+
+static TraceThread& this_thread_buffer()
+{
+  if (!current_thread) {
+    lock_guard<mutex> lock(trace_threads_mutex);
+    current_thread = make_shared<TraceThread>();
+    current_thread->tid = trace_threads.size() + 1;
+    trace_threads.push_back(current_thread);
+  }
+  return *current_thread;
+}
+
+
+
+/* Chrome trace-event JSON: one complete ("X") event per span, timestamps in
+ * microseconds from trace_start(), plus thread name metadata. Recording stops
+ * first: spans from static destructors would outlive the thread buffers. */
+static void trace_write()
+{
+  trace_enabled = false;
+  FILE *trace_file = fopen(trace_path.c_str(), "w");
+  if (trace_file == NULL) {
+    fprintf(stderr, "fopen(%s) failed: %s\n", trace_path.c_str(), strerror(errno));
+    return;
+  }
+
+  lock_guard<mutex> lock(trace_threads_mutex);
+  int pid = getpid();
+  long event_count = 0, dropped = 0;
+  bool is_first = true;
+
+  fprintf(trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (const auto& thread : trace_threads) {
+    if (thread->name != nullptr) {
+      fprintf(trace_file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+              is_first ? "" : ",\n", pid, thread->tid, thread->name);
+      is_first = false;
+    }
+    for (const TraceEvent& event : thread->events) {
+      fprintf(trace_file, "%s{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+              is_first ? "" : ",\n", event.name, event.category, pid, thread->tid,
+              (event.start_ns - trace_origin_ns) / 1e3, event.duration_ns / 1e3);
+      if (event.arg != -1) {
+        fprintf(trace_file, ",\"args\":{\"value\":%ld}", event.arg);
+      }
+      fprintf(trace_file, "}");
+      is_first = false;
+    }
+    event_count += thread->events.size();
+    dropped += thread->dropped;
+  }
+  fprintf(trace_file, "\n]}\n");
+  fclose(trace_file);
+
+  fprintf(stderr, "Trace of %ld events written to %s", event_count, trace_path.c_str());
+  if (dropped > 0) {
+    fprintf(stderr, " (%ld dropped past the per-thread limit)", dropped);
+  }
+  fprintf(stderr, "\n");
+}
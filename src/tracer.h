@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_TRACER_H
+#define RADMON_TRACER_H
+
+// Includes
+#include <time.h>
+#include <unistd.h>
+
+// Constants
+#define TRACE_MAX_EVENTS_PER_THREAD 4000000 /* ~160 MB; later events are counted, not kept */
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+/* Times the rest of the enclosing scope as one span. */
+#define TRACE_SPAN(name, category) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, category)
+
+// Global Variables
+/* Set once by trace_start() before any worker thread exists, so a plain bool
+ * is enough; when false a span costs one predictable branch. */
+extern bool trace_enabled;
+
+// Function Prototypes
+int trace_start(const char *trace_path);
+void trace_record(const char *name, const char *category, long start_ns, long end_ns, long arg);
+void trace_thread_name(const char *name);
+void traced_usleep(useconds_t usec);
+
+// Inline Definitions
+inline long trace_now_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+// Type Definitions
+/* Names and categories must be string literals: only the pointers are kept
+ * until the trace is written. arg, when set, shows up as args.value. */
+class TraceSpan {
+  public:
+    long arg = -1;
+
+    TraceSpan(const char *name, const char *category)
+      : name(name), category(category)
+    {
+      if (trace_enabled) {
+        start_ns = trace_now_ns();
+      }
+    }
+
+    ~TraceSpan()
+    {
+      if (start_ns != 0 && trace_enabled) {
+        trace_record(name, category, start_ns, trace_now_ns(), arg);
+      }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+  private:
+    const char *name;
+    const char *category;
+    long start_ns = 0;
+};
+
+#endif
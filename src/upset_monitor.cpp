@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Includes
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <vector>
+
+#include "logger.h"
+#include "upset_monitor.h"
+
+using namespace std;
+
+extern char **environ;
+
+
+
+// Function Definitions
+/* Starts checking a dump against expected_pattern, forgetting the counts of
+ * any earlier dump. UPSET_NO_PATTERN leaves the dump unchecked. */
+void UpsetMonitor::begin(int expected_pattern, const char *dump_name)
+{
+  flips = flips_to_one = flips_to_zero = alerts = 0;
+  region_flips.clear();
+  upsets.clear();
+  burst_start = 0;
+  burst_flips = 0;
+  is_burst_alerted = false;
+  this->dump_name = dump_name;
+  reap_hooks();
+
+  is_active = is_enabled && expected_pattern != UPSET_NO_PATTERN;
+  if (!is_active) {
+    if (is_enabled) {
+      sprintf(debug_output, "Upset check of %s skipped: no fill or clear to compare against", dump_name);
+      logger.log(debug_output, INFO);
+    }
+    return;
+  }
+  this->expected_pattern = expected_pattern;
+  expected_word = 0x0101010101010101ULL * this->expected_pattern;
+}
+
+
+
+void UpsetMonitor::end()
+{
+  if (!is_active) {
+    return;
+  }
+  is_active = false;
+  sprintf(debug_output, "Upset check of %s against 0x%02x: %d flipped bits (%d to one, %d to zero), %d alerts",
+          dump_name.c_str(), expected_pattern, flips, flips_to_one, flips_to_zero, alerts);
+  logger.log(debug_output, alerts > 0 ? WARN : INFO);
+  reap_hooks();
+}
+
+
+
+/* Hooks still running are left to finish on their own. */
+UpsetMonitor::~UpsetMonitor()
+{
+  reap_hooks();
+}
+
+
+
+/* The slow path of check(), for a frame with at least one flipped bit. A
+ * region alerts once, when its count first reaches the threshold. A burst
+ * alerts when the window reaches its limit and again only after a whole
+ * window has gone by without an upset. */
+void UpsetMonitor::record(int frame_index, uint64_t diff)
+{
+  int word_flips = __builtin_popcountll(diff);
+  int to_one = __builtin_popcountll(diff & (diff ^ expected_word));
+  int region = frame_index / UPSET_REGION_FRAMES;
+  char message[256];
+
+  flips += word_flips;
+  flips_to_one += to_one;
+  flips_to_zero += word_flips - to_one;
+  if (region >= (int)region_flips.size()) {
+    region_flips.resize(region + 1, 0);
+  }
+  int region_before = region_flips[region];
+  region_flips[region] += word_flips;
+
+  while (burst_start < upsets.size() && upsets[burst_start].frame <= frame_index - spec.burst_frames) {
+    burst_flips -= __builtin_popcountll(upsets[burst_start].diff);
+    burst_start++;
+  }
+  if (burst_start == upsets.size()) {
+    is_burst_alerted = false;
+  }
+  upsets.push_back({frame_index, diff});
+  burst_flips += word_flips;
+
+  if (spec.threshold > 0 && region_before < spec.threshold && region_flips[region] >= spec.threshold) {
+    size_t first = upsets.size() - 1;
+    while (first > 0 && upsets[first - 1].frame / UPSET_REGION_FRAMES == region) {
+      first--;
+    }
+    snprintf(message, sizeof(message), "Upset alert: region %d (0x%04x-0x%04x) of %s reached %d flipped bits",
+             region, region * UPSET_REGION_FRAMES * 8, (region + 1) * UPSET_REGION_FRAMES * 8 - 1,
+             dump_name.c_str(), region_flips[region]);
+    alert("region", region, region_flips[region], message, list_addresses(first, upsets.size()));
+  }
+
+  if (spec.burst_flips > 0 && !is_burst_alerted && burst_flips >= spec.burst_flips) {
+    is_burst_alerted = true;
+    snprintf(message, sizeof(message), "Upset alert: burst of %d flipped bits within %d frames of %s",
+             burst_flips, spec.burst_frames, dump_name.c_str());
+    alert("burst", region, burst_flips, message, list_addresses(burst_start, upsets.size()));
+  }
+}
+
+
+
+/* "0xADDR^MASK ..." for each flipped byte of upsets[first, last), with FRAM
+ * addresses and the XOR of what was read against what was expected. */
+string UpsetMonitor::list_addresses(size_t first, size_t last) const
+{
+  string addresses;
+  char entry[32];
+  int listed = 0, more = 0;
+
+  for (size_t i = first; i < last; i++) {
+    unsigned char diff_bytes[8];
+    memcpy(diff_bytes, &upsets[i].diff, sizeof(diff_bytes));
+    for (int j = 0; j < 8; j++) {
+      if (diff_bytes[j] == 0) {
+        continue;
+      }
+      if (listed == UPSET_ALERT_ADDRESSES) {
+        more++;
+        continue;
+      }
+      snprintf(entry, sizeof(entry), "%s0x%04x^%02x", listed > 0 ? " " : "", upsets[i].frame * 8 + j, diff_bytes[j]);
+      addresses += entry;
+      listed++;
+    }
+  }
+  if (more > 0) {
+    snprintf(entry, sizeof(entry), " (+%d more)", more);
+    addresses += entry;
+  }
+  return addresses;
+}
+
+
+
+void UpsetMonitor::alert(const char *kind, int region, int alert_flips, const string& message,
+                         const string& addresses)
+{
+  alerts++;
+  string line = message + ": " + addresses;
+  logger.log(line, WARN);
+  fprintf(stderr, "%s\n", line.c_str());
+  if (!spec.hook.empty()) {
+    run_hook(kind, region, alert_flips, message, addresses);
+  }
+}
+
+
+
+/* Runs the hook through the shell with the alert in its environment. The
+ * dump carries on at once; the hook is reaped at a later alert or when the
+ * dump ends. */
+void UpsetMonitor::run_hook(const char *kind, int region, int alert_flips, const string& message,
+                            const string& addresses)
+{
+  vector<string> alert_env = {
+    string("RADMON_UPSET_KIND=") + kind,
+    "RADMON_UPSET_DUMP=" + dump_name,
+    "RADMON_UPSET_REGION=" + to_string(region),
+    "RADMON_UPSET_FLIPS=" + to_string(alert_flips),
+    "RADMON_UPSET_ADDRESSES=" + addresses,
+    "RADMON_UPSET_MESSAGE=" + message,
+  };
+  vector<char *> envp;
+  for (char **env = environ; *env != nullptr; env++) {
+    envp.push_back(*env);
+  }
+  for (auto& entry : alert_env) {
+    envp.push_back(entry.data());
+  }
+  envp.push_back(nullptr);
+  char *argv[] = { (char *)"sh", (char *)"-c", spec.hook.data(), nullptr };
+
+  reap_hooks();
+  pid_t pid;
+  int result = posix_spawn(&pid, UPSET_HOOK_SHELL, nullptr, nullptr, argv, envp.data());
+  if (result != 0) {
+    sprintf(debug_output, "Unable to run upset hook: %s", strerror(result));
+    logger.log(debug_output, ERROR);
+    return;
+  }
+  hooks.push_back(pid);
+}
+
+
+
+void UpsetMonitor::reap_hooks()
+{
+  size_t kept = 0;
+
+  for (pid_t pid : hooks) {
+    int status;
+    pid_t result = waitpid(pid, &status, WNOHANG);
+    if (result == 0) {
+      hooks[kept++] = pid;
+    } else if (result == pid && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+      sprintf(debug_output, "Upset hook %d failed with status %d", (int)pid, status);
+      logger.log(debug_output, WARN);
+    }
+  }
+  hooks.resize(kept);
+}
+
+
+
+/* Parses "THRESHOLD[:FLIPS/FRAMES[:PATTERN]]". A limit of 0 turns that alert
+ * off. PATTERN is fill, clear or a hex byte, and is only used for dumps this
+ * session did not fill or clear first. */
+int parse_upset_spec(const char *arg, UpsetSpec& spec)
+{
+  char *end;
+  string hook = spec.hook;
+
+  spec = UpsetSpec();
+  spec.hook = hook;
+  spec.threshold = strtol(arg, &end, 10);
+  if (end == arg || spec.threshold < 0) {
+    return -1;
+  }
+  if (*end == '\0') {
+    return 0;
+  }
+  if (*end != ':') {
+    return -1;
+  }
+
+  arg = end + 1;
+  spec.burst_flips = strtol(arg, &end, 10);
+  if (end == arg || *end != '/' || spec.burst_flips < 0) {
+    return -1;
+  }
+  arg = end + 1;
+  spec.burst_frames = strtol(arg, &end, 10);
+  if (end == arg || spec.burst_frames < 1) {
+    return -1;
+  }
+  if (*end == '\0') {
+    return 0;
+  }
+  if (*end != ':') {
+    return -1;
+  }
+
+  string pattern(end + 1);
+  if (pattern == "fill") {
+    spec.pattern = UPSET_FILL_PATTERN;
+  } else if (pattern == "clear") {
+    spec.pattern = UPSET_CLEAR_PATTERN;
+  } else {
+    arg = pattern.c_str();
+    spec.pattern = strtol(arg, &end, 16);
+    if (end == arg || *end != '\0' || spec.pattern < 0 || spec.pattern > 0xff) {
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RADMON_UPSET_MONITOR_H
+#define RADMON_UPSET_MONITOR_H
+
+// Includes
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+// Constants
+#define UPSET_FILL_PATTERN 0xff      /* what a fill leaves in FRAM, as radmon-analyze assumes */
+#define UPSET_CLEAR_PATTERN 0x00
+#define UPSET_NO_PATTERN -1          /* nothing known to compare against, the dump is not checked */
+#define UPSET_REGION_FRAMES 256      /* FRAM (2kB) per region */
+#define UPSET_THRESHOLD_DEFAULT 8    /* flipped bits in one region */
+#define UPSET_BURST_FLIPS_DEFAULT 4  /* flipped bits ... */
+#define UPSET_BURST_FRAMES_DEFAULT 16 /* ... within this many consecutive frames */
+#define UPSET_ALERT_ADDRESSES 16     /* listed per alert, the rest are counted */
+#define UPSET_HOOK_SHELL "/bin/sh"
+
+// Type Definitions
+struct UpsetSpec {
+  int threshold = UPSET_THRESHOLD_DEFAULT;
+  int burst_flips = UPSET_BURST_FLIPS_DEFAULT;
+  int burst_frames = UPSET_BURST_FRAMES_DEFAULT;
+  int pattern = UPSET_NO_PATTERN; /* expected byte when this session sent no fill or clear */
+  std::string hook;               /* shell command run on every alert, optional */
+};
+
+/* A frame that differed from the expected pattern. */
+struct UpsetWord {
+  int frame;
+  uint64_t diff; /* data XOR expected, in memory order */
+};
+
+/* Compares each dump frame with the pattern the payload memory should hold
+ * while the dump is still arriving. A clean frame costs a load, an XOR and
+ * a branch; only frames that differ are counted per region and in a sliding
+ * burst window. Crossing either limit logs an alert with the flipped
+ * addresses and hands it to the hook command without waiting for it. */
+class UpsetMonitor {
+  public:
+    UpsetSpec spec;
+    bool is_enabled = false;
+    int flips = 0;          /* this dump */
+    int flips_to_one = 0;
+    int flips_to_zero = 0;
+    int alerts = 0;
+
+    void begin(int expected_pattern, const char *dump_name);
+    inline void check(int frame_index, const unsigned char *data);
+    void end();
+    ~UpsetMonitor();
+
+  private:
+    bool is_active = false;
+    unsigned char expected_pattern = 0;
+    uint64_t expected_word = 0;
+    std::string dump_name;
+    std::vector<int> region_flips;
+    std::vector<UpsetWord> upsets; /* in arrival order */
+    size_t burst_start = 0;        /* first of upsets inside the burst window */
+    int burst_flips = 0;
+    bool is_burst_alerted = false; /* re-armed once the window has drained */
+    std::vector<pid_t> hooks;      /* not yet reaped */
+
+    void record(int frame_index, uint64_t diff);
+    std::string list_addresses(size_t first, size_t last) const;
+    void alert(const char *kind, int region, int alert_flips, const std::string& message,
+               const std::string& addresses);
+    void run_hook(const char *kind, int region, int alert_flips, const std::string& message,
+                  const std::string& addresses);
+    void reap_hooks();
+};
+
+// Function Prototypes
+int parse_upset_spec(const char *arg, UpsetSpec& spec);
+
+// Inline Definitions
+void UpsetMonitor::check(int frame_index, const unsigned char *data)
+{
+  uint64_t word;
+
+  if (!is_active) {
+    return;
+  }
+  memcpy(&word, data, sizeof(word));
+  if (__builtin_expect(word != expected_word, 0)) {
+    record(frame_index, word ^ expected_word);
+  }
+}
+
+#endif
@@ -0,0 +1,688 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Pseudo-terminal stand-in for the USB-CAN adapter.
+ *
+ * Opens a pty pair and prints the slave path; radmon-client is pointed at
+ * it with -d. Settings frames are checked and applied, and data frames are
+ * timed through a simple link model: serial time at the baud rate the client
+ * set on the slave (8N2, 11 bits a byte), CAN frame time at the configured
+ * bus speed, and a bounded adapter TX queue that drops frames when the host
+ * sends faster than the bus drains. In CANUSB_MODE_LOOPBACK and
+ * CANUSB_MODE_LOOPBACK_SILENT every transmitted frame is echoed back.
+ *
+ * With -p, radmon payloads are emulated on the same bus: they answer dump
+ * commands from a memory image that fill and clear overwrite, including the
+ * optional ranged dump. Their frames take the bus only when it is idle, so
+ * host traffic slows a dump down. -u flips bits of the image after every fill
+ * or clear, as radiation would. -x damages frames on their way to the host,
+ * and -B and -C model a link that fails above some serial or CAN rate.
+ *
+ * SIGUSR1 unplugs the adapter: the pty is closed, so the client sees the
+ * hangup a USB reset causes, and a new one appears behind LINK after the
+ * outage. Payloads keep transmitting into the void meanwhile.
+ *
+ * Usage: bin/canusb-sim [-l LINK] [-q DEPTH] [-x PROB] [-B BAUDRATE] [-C SPEED] [-p SEND_ID:RECV_ID]... [-u FLIPS[:SPAN]] [-D MS] [-v]
+ */
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h> /* struct termios2 */
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "canusb.h"
+#include "frame.h"
+#include "radmon.h"
+
+using namespace std;
+
+// Constants
+#define SIM_TX_QUEUE_DEPTH_DEFAULT 32 /* frames waiting for the bus */
+#define SIM_SERIAL_BITS_PER_BYTE 11   /* start, 8 data, 2 stop */
+#define SIM_OUTAGE_MS_DEFAULT 3000    /* how long SIGUSR1 unplugs the adapter */
+
+// Type Definitions
+struct LinkModel {
+  int tx_queue_depth = SIM_TX_QUEUE_DEPTH_DEFAULT;
+  double byte_loss = 0; /* chance a frame to the host loses one byte */
+  int max_baudrate = 0;  /* faster serial damages every frame to the host, 0 for no limit */
+  int max_can_speed = 0; /* faster CAN loses every frame on the bus, 0 for no limit */
+};
+
+struct UpsetModel {
+  int flips = 0; /* bits flipped after every fill or clear */
+  int span = 0;  /* bytes they fall within, from a random start; 0 for the whole image */
+  unsigned short seed[3] = { 0x5eed, 0x0043, 0x0001 }; /* apart from frame loss, so runs repeat */
+};
+
+struct PendingFrame {
+  long due_ns;
+  int len;
+  unsigned char bytes[CANUSB_FRAME_BUFFER_SIZE];
+};
+
+struct SimPayload {
+  unsigned short inject_id;
+  unsigned short receive_id;
+  vector<unsigned char> memory = vector<unsigned char>(RADMON_FULL_DUMP_FRAMES * 8, 0x00);
+  int next_frame = 0;
+  int frames_pending = 0;
+  long ready_ns = 0;  /* a command is acted on once it has crossed the bus */
+};
+
+struct SimAdapter {
+  int master_fd;
+  int can_speed = CANUSB_CAN_SPEED_DEFAULT;
+  int mode = CANUSB_MODE_NORMAL;
+  long serial_in_free_ns = 0;
+  long can_free_ns = 0;
+  long serial_out_free_ns = 0;
+  deque<long> can_queue;          /* bus completion times of queued frames */
+  deque<PendingFrame> to_host;    /* frames on their way back over serial */
+  vector<SimPayload> payloads;
+  long frames_in = 0;
+  long frames_dropped = 0;
+  long frames_to_host = 0;
+  long frames_damaged = 0;
+};
+
+// Global Variables
+static volatile sig_atomic_t program_running = 1;
+static volatile sig_atomic_t is_unplug_requested = 0;
+static int verbose = 0;
+static UpsetModel upsets;
+
+
+// Function Prototypes
+static void display_help(const char *progname);
+static void sigterm(int signo);
+static void sigusr1(int signo);
+static int open_pty(SimAdapter& adapter, int *slave_fd, const char *link_path);
+static void unplug(SimAdapter& adapter, int *slave_fd, const char *link_path, int outage_ms);
+static long monotonic_ns();
+static long serial_baudrate(int master_fd);
+static long serial_byte_ns(int master_fd);
+static bool is_bus_overdriven(const SimAdapter& adapter, const LinkModel& link);
+static void handle_settings_frame(SimAdapter& adapter, const unsigned char *frame);
+static void handle_data_frame(SimAdapter& adapter, const LinkModel& link, const unsigned char *frame, int frame_len);
+static void handle_payload_command(SimPayload& payload, const unsigned char *frame, long bus_done_ns);
+static void flip_bits(SimPayload& payload);
+static void schedule_to_host(SimAdapter& adapter, const unsigned char *frame, int frame_len, long bus_done_ns);
+static long bus_frame_ns(const SimAdapter& adapter, int dlc);
+static SimPayload *next_payload_frame(SimAdapter& adapter, long now_ns);
+static void transmit_payload_frames(SimAdapter& adapter, const LinkModel& link);
+static long next_payload_ns(SimAdapter& adapter);
+static void deliver_due_frames(SimAdapter& adapter, const LinkModel& link);
+
+
+
+int main(int argc, char *argv[])
+{
+  int c, slave_fd;
+  const char *link_path = NULL;
+  int outage_ms = SIM_OUTAGE_MS_DEFAULT;
+  LinkModel link;
+  SimAdapter adapter;
+
+  while ((c = getopt(argc, argv, "hl:q:x:B:C:p:u:D:v")) != -1) {
+    switch (c) {
+    case 'p': {
+      char *recv_id = strchr(optarg, ':');
+      SimPayload payload;
+      if (recv_id == NULL) {
+        fprintf(stderr, "Invalid payload IDs: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      *recv_id++ = '\0';
+      if (parse_can_id(optarg, &payload.inject_id) == -1 || parse_can_id(recv_id, &payload.receive_id) == -1) {
+        fprintf(stderr, "Invalid payload IDs: %s:%s\n", optarg, recv_id);
+        return EXIT_FAILURE;
+      }
+      adapter.payloads.push_back(payload);
+      break;
+    }
+
+    case 'l':
+      link_path = optarg;
+      break;
+
+    case 'q':
+      link.tx_queue_depth = atoi(optarg);
+      if (link.tx_queue_depth < 1) {
+        fprintf(stderr, "Invalid TX queue depth: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'x':
+      link.byte_loss = atof(optarg);
+      break;
+
+    case 'B':
+      link.max_baudrate = atoi(optarg);
+      break;
+
+    case 'C':
+      link.max_can_speed = atoi(optarg);
+      break;
+
+    case 'u':
+      if (sscanf(optarg, "%d:%d", &upsets.flips, &upsets.span) < 1 || upsets.flips < 0 || upsets.span < 0) {
+        fprintf(stderr, "Invalid upsets: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'D':
+      outage_ms = atoi(optarg);
+      break;
+
+    case 'v':
+      verbose = 1;
+      break;
+
+    case 'h':
+      display_help(argv[0]);
+      return EXIT_SUCCESS;
+
+    case '?':
+    default:
+      display_help(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (open_pty(adapter, &slave_fd, link_path) == -1) {
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGTERM, sigterm);
+  signal(SIGINT, sigterm);
+  signal(SIGUSR1, sigusr1);
+
+  unsigned char buffer[CANUSB_READ_BUFFER_SIZE];
+  unsigned char frame[CANUSB_FRAME_BUFFER_SIZE];
+  int frame_len = 0;
+  struct pollfd pfd = {};
+  pfd.fd = adapter.master_fd;
+  pfd.events = POLLIN;
+
+  while (program_running) {
+    if (is_unplug_requested) {
+      is_unplug_requested = 0;
+      unplug(adapter, &slave_fd, link_path, outage_ms);
+      pfd.fd = adapter.master_fd;
+      frame_len = 0;
+      continue;
+    }
+
+    struct timespec timeout, *timeout_ptr = NULL;
+    long wake_ns = next_payload_ns(adapter);
+    if (!adapter.to_host.empty() && (wake_ns == -1 || adapter.to_host.front().due_ns < wake_ns)) {
+      wake_ns = adapter.to_host.front().due_ns;
+    }
+    if (wake_ns != -1) {
+      long wait_ns = max(0L, wake_ns - monotonic_ns());
+      timeout.tv_sec = wait_ns / 1000000000L;
+      timeout.tv_nsec = wait_ns % 1000000000L;
+      timeout_ptr = &timeout;
+    }
+
+    int result = ppoll(&pfd, 1, timeout_ptr, NULL);
+    if (result == -1 && errno != EINTR) {
+      fprintf(stderr, "ppoll() failed: %s\n", strerror(errno));
+      break;
+    }
+
+    if (result > 0 && (pfd.revents & POLLIN)) {
+      int len = read(adapter.master_fd, buffer, sizeof(buffer));
+      if (len == -1 && errno != EAGAIN) {
+        fprintf(stderr, "read() failed: %s\n", strerror(errno));
+        break;
+      }
+      for (int i = 0; i < len; i++) {
+        frame[frame_len++] = buffer[i];
+        if (!frame_is_complete(frame, frame_len)) {
+          continue;
+        }
+        if (frame_len == 20 && frame[1] == 0x55) {
+          handle_settings_frame(adapter, frame);
+        } else if ((frame[1] >> 4) == 0xc && frame[frame_len - 1] == 0x55) {
+          handle_data_frame(adapter, link, frame, frame_len);
+        }
+        frame_len = 0;
+      }
+    }
+
+    transmit_payload_frames(adapter, link);
+    deliver_due_frames(adapter, link);
+  }
+
+  fprintf(stderr, "%ld frames in, %ld dropped, %ld sent to host, %ld damaged\n", adapter.frames_in,
+          adapter.frames_dropped, adapter.frames_to_host, adapter.frames_damaged);
+  if (link_path != NULL) {
+    unlink(link_path);
+  }
+  close(slave_fd);
+  close(adapter.master_fd);
+  return EXIT_SUCCESS;
+}
+
+
+
+// Function Definitions
+static void display_help(const char *progname)
+{
+  fprintf(stderr, "Usage: %s <options>\n", progname);
+  fprintf(stderr, "Options:\n"
+     "  -h          Display this help and exit.\n"
+     "  -l LINK     Also make the pty reachable as symlink LINK.\n"
+     "  -q DEPTH    Adapter TX queue depth in frames (default: %d).\n"
+     "  -x PROB     Chance that a frame to the host loses one byte (default: 0).\n"
+     "  -B BAUDRATE Damage every frame to the host above this serial baudrate.\n"
+     "  -C SPEED    Lose every frame on the bus above this CAN speed.\n"
+     "  -p SEND_ID:RECV_ID\n"
+     "              Emulate a radmon payload on the bus (repeatable).\n"
+     "  -u FLIPS[:SPAN]\n"
+     "              Flip FLIPS random bits of payload memory after every fill or clear, all\n"
+     "              within SPAN bytes when given.\n"
+     "  -D MS       Outage when SIGUSR1 unplugs the adapter (default: %d).\n"
+     "  -v          Print every frame received from the host.\n"
+     "\n",
+     SIM_TX_QUEUE_DEPTH_DEFAULT,
+     SIM_OUTAGE_MS_DEFAULT);
+}
+
+
+
+static void sigterm(int signo)
+{
+  program_running = 0;
+}
+
+
+
+static void sigusr1(int signo)
+{
+  is_unplug_requested = 1;
+}
+
+
+
+/* Opens a fresh pty pair and prints the slave path. Holding the slave open
+ * keeps the master readable between client runs instead of returning EIO
+ * once the last client closes it. It is made raw so nothing is echoed back
+ * before a client configures it. */
+static int open_pty(SimAdapter& adapter, int *slave_fd, const char *link_path)
+{
+  adapter.master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (adapter.master_fd == -1 || grantpt(adapter.master_fd) == -1 || unlockpt(adapter.master_fd) == -1) {
+    fprintf(stderr, "Unable to open a pseudo-terminal: %s\n", strerror(errno));
+    return -1;
+  }
+  const char *slave_path = ptsname(adapter.master_fd);
+
+  *slave_fd = open(slave_path, O_RDWR | O_NOCTTY);
+  if (*slave_fd == -1) {
+    fprintf(stderr, "open(%s) failed: %s\n", slave_path, strerror(errno));
+    return -1;
+  }
+  struct termios2 tio;
+  if (ioctl(*slave_fd, TCGETS2, &tio) == 0) {
+    tio.c_iflag = 0;
+    tio.c_oflag = 0;
+    tio.c_lflag = 0;
+    ioctl(*slave_fd, TCSETS2, &tio);
+  }
+  fcntl(adapter.master_fd, F_SETFL, O_NONBLOCK);
+
+  if (link_path != NULL) {
+    unlink(link_path);
+    if (symlink(slave_path, link_path) == -1) {
+      fprintf(stderr, "symlink(%s) failed: %s\n", link_path, strerror(errno));
+      return -1;
+    }
+  }
+
+  printf("%s\n", slave_path);
+  fflush(stdout);
+  return 0;
+}
+
+
+
+/* Whatever was in flight to the host is lost, and the payloads' dumps move
+ * on by as many frames as the bus carried during the outage. */
+static void unplug(SimAdapter& adapter, int *slave_fd, const char *link_path, int outage_ms)
+{
+  fprintf(stderr, "Unplugged for %d ms\n", outage_ms);
+  if (link_path != NULL) {
+    unlink(link_path);
+  }
+  close(*slave_fd);
+  close(adapter.master_fd);
+  adapter.to_host.clear();
+  adapter.can_queue.clear();
+
+  usleep(outage_ms * 1000L);
+
+  long now_ns = monotonic_ns();
+  long missed_frames = (now_ns - max(adapter.can_free_ns, now_ns - outage_ms * 1000000L)) / bus_frame_ns(adapter, 8);
+  for (SimPayload& payload : adapter.payloads) {
+    int skipped = min((long)payload.frames_pending, missed_frames);
+    payload.next_frame += skipped;
+    payload.frames_pending -= skipped;
+  }
+  adapter.can_free_ns = adapter.serial_in_free_ns = adapter.serial_out_free_ns = now_ns;
+
+  if (open_pty(adapter, slave_fd, link_path) == -1) {
+    program_running = 0;
+  }
+}
+
+
+
+static long monotonic_ns()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+
+
+/* The pty master reports the termios of its slave, so this is the baud rate
+ * the client asked for in adapter_init. */
+static long serial_baudrate(int master_fd)
+{
+  struct termios2 tio;
+
+  if (ioctl(master_fd, TCGETS2, &tio) == 0 && tio.c_ospeed > 0) {
+    return tio.c_ospeed;
+  }
+  return CANUSB_TTY_BAUD_RATE_DEFAULT;
+}
+
+
+
+static long serial_byte_ns(int master_fd)
+{
+  return SIM_SERIAL_BITS_PER_BYTE * 1000000000L / serial_baudrate(master_fd);
+}
+
+
+
+/* A bus run faster than its length and transceivers allow: every frame ends
+ * in an error frame, but still takes the bus for its length. */
+static bool is_bus_overdriven(const SimAdapter& adapter, const LinkModel& link)
+{
+  return link.max_can_speed > 0 && adapter.can_speed > link.max_can_speed;
+}
+
+
+
+static void handle_settings_frame(SimAdapter& adapter, const unsigned char *frame)
+{
+  if (generate_checksum(&frame[2], 17) != frame[19]) {
+    fprintf(stderr, "Settings frame with bad checksum ignored\n");
+    return;
+  }
+
+  int can_speed = canusb_speed_to_int((CANUSB_SPEED)frame[3]);
+  if (can_speed == 0) {
+    fprintf(stderr, "Settings frame with unknown speed 0x%02x ignored\n", frame[3]);
+    return;
+  }
+  adapter.can_speed = can_speed;
+  adapter.mode = frame[13];
+  fprintf(stderr, "Settings: %d bps, mode 0x%02x\n", adapter.can_speed, adapter.mode);
+}
+
+
+
+static void handle_data_frame(SimAdapter& adapter, const LinkModel& link, const unsigned char *frame, int frame_len)
+{
+  long now_ns = monotonic_ns();
+  long byte_ns = serial_byte_ns(adapter.master_fd);
+
+  adapter.frames_in++;
+  if (verbose) {
+    fprintf(stderr, "<<< ");
+    for (int i = 0; i < frame_len; i++) {
+      fprintf(stderr, "%02x ", frame[i]);
+    }
+    fprintf(stderr, "\n");
+  }
+
+  adapter.serial_in_free_ns = max(now_ns, adapter.serial_in_free_ns) + frame_len * byte_ns;
+  while (!adapter.can_queue.empty() && adapter.can_queue.front() <= adapter.serial_in_free_ns) {
+    adapter.can_queue.pop_front();
+  }
+  if ((int)adapter.can_queue.size() >= link.tx_queue_depth) {
+    adapter.frames_dropped++;
+    return;
+  }
+
+  adapter.can_free_ns = max(adapter.serial_in_free_ns, adapter.can_free_ns) + bus_frame_ns(adapter, frame[1] & 0x0f);
+  adapter.can_queue.push_back(adapter.can_free_ns);
+  if (is_bus_overdriven(adapter, link)) {
+    adapter.frames_dropped++;
+    return;
+  }
+
+  if (adapter.mode & CANUSB_MODE_LOOPBACK) {
+    schedule_to_host(adapter, frame, frame_len, adapter.can_free_ns);
+  }
+  if (!(adapter.mode & CANUSB_MODE_SILENT)) {
+    unsigned short id = frame[2] | (frame[3] << 8);
+    for (SimPayload& payload : adapter.payloads) {
+      if (payload.inject_id == id) {
+        handle_payload_command(payload, frame, adapter.can_free_ns);
+      }
+    }
+  }
+}
+
+
+
+static void handle_payload_command(SimPayload& payload, const unsigned char *frame, long bus_done_ns)
+{
+  if ((frame[1] & 0x0f) < 1) {
+    return;
+  }
+
+  switch (frame[4]) {
+  case RADMON_CMD_FULL_DUMP:
+    payload.next_frame = 0;
+    payload.frames_pending = RADMON_FULL_DUMP_FRAMES;
+    break;
+
+  case RADMON_CMD_PART_DUMP:
+    payload.next_frame = 0;
+    payload.frames_pending = RADMON_PART_DUMP_FRAMES;
+    break;
+
+  case RADMON_CMD_RANGE_DUMP:
+    if ((frame[1] & 0x0f) < 5) {
+      return;
+    }
+    payload.next_frame = min((frame[5] << 8) | frame[6], RADMON_FULL_DUMP_FRAMES);
+    payload.frames_pending = min((frame[7] << 8) | frame[8], RADMON_FULL_DUMP_FRAMES - payload.next_frame);
+    break;
+
+  case RADMON_CMD_FILL:
+    fill(payload.memory.begin(), payload.memory.end(), 0xff);
+    flip_bits(payload);
+    break;
+
+  case RADMON_CMD_CLEAR:
+    fill(payload.memory.begin(), payload.memory.end(), 0x00);
+    flip_bits(payload);
+    break;
+
+  default:
+    return;
+  }
+  payload.ready_ns = bus_done_ns;
+  if (verbose) {
+    fprintf(stderr, "Payload %03x: command 0x%02x\n", payload.inject_id, frame[4]);
+  }
+}
+
+
+
+/* Flips upsets.flips random bits within a random span of the payload memory. */
+static void flip_bits(SimPayload& payload)
+{
+  int size = payload.memory.size();
+  int span = upsets.span > 0 ? min(upsets.span, size) : size;
+  int start = nrand48(upsets.seed) % (size - span + 1);
+
+  for (int k = 0; k < upsets.flips; k++) {
+    int bit = nrand48(upsets.seed) % (span * 8);
+    payload.memory[start + bit / 8] ^= 1 << (bit % 8);
+  }
+  if (verbose && upsets.flips > 0) {
+    fprintf(stderr, "Payload %03x: %d bits flipped within 0x%04x-0x%04x\n",
+            payload.inject_id, upsets.flips, start, start + span - 1);
+  }
+}
+
+
+
+/* Queues a frame that finished on the bus at bus_done_ns for the serial link
+ * back to the host. Serial output is in bus order, so to_host stays sorted. */
+static void schedule_to_host(SimAdapter& adapter, const unsigned char *frame, int frame_len, long bus_done_ns)
+{
+  PendingFrame pending;
+
+  adapter.serial_out_free_ns = max(bus_done_ns, adapter.serial_out_free_ns)
+                               + frame_len * serial_byte_ns(adapter.master_fd);
+  pending.due_ns = adapter.serial_out_free_ns;
+  pending.len = frame_len;
+  memcpy(pending.bytes, frame, frame_len);
+  adapter.to_host.push_back(pending);
+}
+
+
+
+/* A standard data frame with DLC n is 47 + 8n bits on the bus before
+ * stuffing; one stuff bit per five of the stuffable 34 + 8n is assumed. */
+static long bus_frame_ns(const SimAdapter& adapter, int dlc)
+{
+  long bus_bits = 47 + 8 * dlc + (34 + 8 * dlc) / 5;
+  return bus_bits * 1000000000L / adapter.can_speed;
+}
+
+
+
+/* The pending payload with the lowest receive ID wins arbitration. */
+static SimPayload *next_payload_frame(SimAdapter& adapter, long now_ns)
+{
+  SimPayload *winner = NULL;
+
+  for (SimPayload& payload : adapter.payloads) {
+    if (payload.frames_pending > 0 && payload.ready_ns <= now_ns
+        && (winner == NULL || payload.receive_id < winner->receive_id)) {
+      winner = &payload;
+    }
+  }
+  return winner;
+}
+
+
+
+/* Payload frames only start on an idle bus. Frames the host queued first
+ * keep the bus, which is how injected load stretches a dump. */
+static void transmit_payload_frames(SimAdapter& adapter, const LinkModel& link)
+{
+  long now_ns = monotonic_ns();
+  SimPayload *payload;
+
+  while (adapter.can_free_ns <= now_ns && (payload = next_payload_frame(adapter, now_ns)) != NULL) {
+    unsigned char data[8];
+    memcpy(data, &payload->memory[payload->next_frame * 8], sizeof(data));
+    CanusbDataFrame frame = encode_data_frame(payload->receive_id, data, sizeof(data));
+
+    adapter.can_free_ns = max(now_ns, adapter.can_free_ns) + bus_frame_ns(adapter, sizeof(data));
+    if (is_bus_overdriven(adapter, link)) {
+      adapter.frames_dropped++;
+    } else {
+      schedule_to_host(adapter, frame.bytes, frame.len, adapter.can_free_ns);
+    }
+    payload->next_frame++;
+    payload->frames_pending--;
+  }
+}
+
+
+
+/* When the next payload frame could start, or -1 if none is pending. */
+static long next_payload_ns(SimAdapter& adapter)
+{
+  long wake_ns = -1;
+
+  for (const SimPayload& payload : adapter.payloads) {
+    if (payload.frames_pending > 0) {
+      long start_ns = max(payload.ready_ns, adapter.can_free_ns);
+      if (wake_ns == -1 || start_ns < wake_ns) {
+        wake_ns = start_ns;
+      }
+    }
+  }
+  return wake_ns;
+}
+
+
+
+static void deliver_due_frames(SimAdapter& adapter, const LinkModel& link)
+{
+  long now_ns = monotonic_ns();
+  bool is_serial_overdriven = link.max_baudrate > 0 && serial_baudrate(adapter.master_fd) > link.max_baudrate;
+
+  while (!adapter.to_host.empty() && adapter.to_host.front().due_ns <= now_ns) {
+    PendingFrame& pending = adapter.to_host.front();
+    /* A byte lost in the adapter or USB stack: the host has to resync. */
+    if (is_serial_overdriven || (link.byte_loss > 0 && drand48() < link.byte_loss)) {
+      int lost = lrand48() % pending.len;
+      memmove(&pending.bytes[lost], &pending.bytes[lost + 1], pending.len - lost - 1);
+      pending.len--;
+      adapter.frames_damaged++;
+    }
+    /* A full pty means no client is reading: the frame is lost, as it would
+     * be from the adapter's USB buffer. */
+    if (write(adapter.master_fd, pending.bytes, pending.len) != pending.len) {
+      adapter.frames_dropped++;
+    } else {
+      adapter.frames_to_host++;
+    }
+    adapter.to_host.pop_front();
+  }
+}
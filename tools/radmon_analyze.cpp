@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Parallel analyzer for the text dumps written by radmon-client.
+ *
+ * Every dump file is memory-mapped and parsed on a pool of worker threads.
+ * For each dump the data bytes are compared against the fill and clear
+ * patterns and the bit flips are written as one CSV line to stdout, along
+ * with whether the dump's checksum index shows it clean or torn. With -o,
+ * each dump is also converted to a compact binary form (see write_binary_dump).
+ *
+ * Usage: bin/radmon-analyze [-j THREADS] [-F FILL] [-C CLEAR] [-B FIRST-LAST]
+ *                           [-o DIR] DUMP|DIR...
+ */
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dump_parser.h"
+#include "durable_writer.h"
+
+using namespace std;
+
+// Constants
+#define ANALYZE_FILL_PATTERN_DEFAULT  0xff
+#define ANALYZE_CLEAR_PATTERN_DEFAULT 0x00
+#define ANALYZE_BINARY_MAGIC "RMB1"
+
+// Type Definitions
+typedef enum {
+  EXPECT_UNKNOWN = 0,
+  EXPECT_FILL    = 1,
+  EXPECT_CLEAR   = 2,
+} EXPECTED_PATTERN;
+
+struct AnalyzeOptions {
+  unsigned char fill_pattern = ANALYZE_FILL_PATTERN_DEFAULT;
+  unsigned char clear_pattern = ANALYZE_CLEAR_PATTERN_DEFAULT;
+  int first_byte = 0;
+  int last_byte = 7;
+  const char *binary_dir = NULL;
+};
+
+struct DumpResult {
+  bool is_ok = false;
+  int data_frames = 0;
+  int unknown_frames = 0;
+  int malformed_lines = 0;
+  EXPECTED_PATTERN expected = EXPECT_UNKNOWN;
+  DURABLE_STATE integrity = DURABLE_NO_INDEX;
+  long fill_flips = 0;   /* bits differing from the fill pattern */
+  long clear_flips = 0;  /* bits differing from the clear pattern */
+  long flips_to_one = 0; /* against the expected pattern */
+  long flips_to_zero = 0;
+};
+
+
+// Function Prototypes
+static void display_help(const char *progname);
+static void collect_paths(const char *path, vector<string>& paths);
+static EXPECTED_PATTERN expected_pattern(const string& path);
+static void analyze_dump(const string& path, const AnalyzeOptions& options, DumpResult& result);
+static void count_flips(const ParsedDump& dump, const AnalyzeOptions& options, DumpResult& result);
+static int write_binary_dump(const string& path, const ParsedDump& dump, const char *binary_dir);
+
+
+
+int main(int argc, char *argv[])
+{
+  int c;
+  int thread_count = thread::hardware_concurrency();
+  AnalyzeOptions options;
+  vector<string> paths;
+
+  while ((c = getopt(argc, argv, "hj:F:C:B:o:")) != -1) {
+    switch (c) {
+    case 'j':
+      thread_count = atoi(optarg);
+      break;
+
+    case 'F':
+      options.fill_pattern = strtoul(optarg, NULL, 16);
+      break;
+
+    case 'C':
+      options.clear_pattern = strtoul(optarg, NULL, 16);
+      break;
+
+    case 'B':
+      if (sscanf(optarg, "%d-%d", &options.first_byte, &options.last_byte) != 2
+          || options.first_byte < 0 || options.last_byte > 7 || options.first_byte > options.last_byte) {
+        fprintf(stderr, "Invalid byte range: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+
+    case 'o':
+      options.binary_dir = optarg;
+      break;
+
+    case 'h':
+      display_help(argv[0]);
+      return EXIT_SUCCESS;
+
+    case '?':
+    default:
+      display_help(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (int i = optind; i < argc; i++) {
+    collect_paths(argv[i], paths);
+  }
+  if (paths.empty()) {
+    display_help(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (thread_count < 1) {
+    thread_count = 1;
+  }
+
+  vector<DumpResult> results(paths.size());
+  atomic<size_t> next_path{0};
+  vector<thread> workers;
+  auto start = chrono::steady_clock::now();
+
+  for (int t = 0; t < thread_count; t++) {
+    workers.emplace_back([&]() {
+      size_t i;
+      while ((i = next_path.fetch_add(1)) < paths.size()) {
+        analyze_dump(paths[i], options, results[i]);
+      }
+    });
+  }
+  for (thread& worker : workers) {
+    worker.join();
+  }
+
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  static const char *expected_names[] = { "-", "fill", "clear" };
+  static const char *integrity_names[] = { "clean", "torn", "-" };
+  int failed = 0;
+
+  printf("path,integrity,data_frames,unknown_frames,malformed_lines,fill_flips,clear_flips,expected,flips_to_one,flips_to_zero\n");
+  for (size_t i = 0; i < paths.size(); i++) {
+    const DumpResult& result = results[i];
+    if (!result.is_ok) {
+      failed++;
+      continue;
+    }
+    printf("%s,%s,%d,%d,%d,%ld,%ld,%s,", paths[i].c_str(), integrity_names[result.integrity],
+           result.data_frames, result.unknown_frames,
+           result.malformed_lines, result.fill_flips, result.clear_flips, expected_names[result.expected]);
+    if (result.expected == EXPECT_UNKNOWN) {
+      printf("-,-\n");
+    } else {
+      printf("%ld,%ld\n", result.flips_to_one, result.flips_to_zero);
+    }
+  }
+
+  fprintf(stderr, "Analyzed %zu dumps in %.3f s (%.0f dumps/s) on %d threads, %d failed.\n",
+          paths.size() - failed, elapsed, (paths.size() - failed) / elapsed, thread_count, failed);
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+
+// Function Definitions
+static void display_help(const char *progname)
+{
+  fprintf(stderr, "Usage: %s <options> DUMP|DIR...\n", progname);
+  fprintf(stderr, "Options:\n"
+     "  -h          Display this help and exit.\n"
+     "  -j THREADS  Worker threads (default: all cores).\n"
+     "  -F FILL     Fill pattern byte in hex (default: %02x).\n"
+     "  -C CLEAR    Clear pattern byte in hex (default: %02x).\n"
+     "  -B F-L      Compare data bytes F to L of each frame (default: 0-7).\n"
+     "  -o DIR      Also write each dump in binary form to DIR.\n"
+     "\n"
+     "Directories are scanned for *.txt dumps. The expected pattern is taken\n"
+     "from the file name: \"fill\" or \"clear\" as written by the test cycle.\n",
+     ANALYZE_FILL_PATTERN_DEFAULT,
+     ANALYZE_CLEAR_PATTERN_DEFAULT);
+}
+
+
+
+static void collect_paths(const char *path, vector<string>& paths)
+{
+  struct stat st;
+
+  if (stat(path, &st) == -1) {
+    fprintf(stderr, "stat(%s) failed: %s\n", path, strerror(errno));
+    return;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    paths.push_back(path);
+    return;
+  }
+
+  DIR *dir = opendir(path);
+  if (dir == NULL) {
+    fprintf(stderr, "opendir(%s) failed: %s\n", path, strerror(errno));
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len > 4 && strcmp(entry->d_name + len - 4, ".txt") == 0) {
+      paths.push_back(string(path) + "/" + entry->d_name);
+    }
+  }
+  closedir(dir);
+}
+
+
+
+static EXPECTED_PATTERN expected_pattern(const string& path)
+{
+  string name = path.substr(path.find_last_of('/') + 1);
+  if (name.find("fill") != string::npos) {
+    return EXPECT_FILL;
+  }
+  if (name.find("clear") != string::npos) {
+    return EXPECT_CLEAR;
+  }
+  return EXPECT_UNKNOWN;
+}
+
+
+
+static void analyze_dump(const string& path, const AnalyzeOptions& options, DumpResult& result)
+{
+  struct stat st;
+  ParsedDump dump;
+  int fd = open(path.c_str(), O_RDONLY);
+
+  if (fd == -1) {
+    fprintf(stderr, "open(%s) failed: %s\n", path.c_str(), strerror(errno));
+    return;
+  }
+  if (fstat(fd, &st) == -1) {
+    fprintf(stderr, "fstat(%s) failed: %s\n", path.c_str(), strerror(errno));
+    close(fd);
+    return;
+  }
+
+  if (st.st_size > 0) {
+    void *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED) {
+      fprintf(stderr, "mmap(%s) failed: %s\n", path.c_str(), strerror(errno));
+      close(fd);
+      return;
+    }
+    madvise(text, st.st_size, MADV_SEQUENTIAL);
+    parse_dump_text((const char *)text, st.st_size, dump);
+    munmap(text, st.st_size);
+  }
+  close(fd);
+
+  result.data_frames = dump.data_frames;
+  result.unknown_frames = dump.unknown_frames;
+  result.malformed_lines = dump.malformed_lines;
+  result.expected = expected_pattern(path);
+  result.integrity = durable_verify(path.c_str(), (path + DURABLE_INDEX_SUFFIX).c_str());
+  count_flips(dump, options, result);
+
+  if (options.binary_dir != NULL && write_binary_dump(path, dump, options.binary_dir) == -1) {
+    return;
+  }
+  result.is_ok = true;
+}
+
+
+
+/* The compared bytes of a frame are packed into one 64-bit word, so each
+ * frame costs four popcounts regardless of the byte range. */
+static void count_flips(const ParsedDump& dump, const AnalyzeOptions& options, DumpResult& result)
+{
+  unsigned char expected = result.expected == EXPECT_CLEAR ? options.clear_pattern : options.fill_pattern;
+  unsigned long long mask = 0;
+
+  for (int j = options.first_byte; j <= options.last_byte; j++) {
+    mask |= 0xffULL << (8 * j);
+  }
+  unsigned long long fill_word = 0x0101010101010101ULL * options.fill_pattern & mask;
+  unsigned long long clear_word = 0x0101010101010101ULL * options.clear_pattern & mask;
+  unsigned long long expected_word = 0x0101010101010101ULL * expected & mask;
+
+  for (const DumpRecord& record : dump.records) {
+    if (record.type != DUMP_RECORD_DATA) {
+      continue;
+    }
+    unsigned long long word;
+    memcpy(&word, record.data, sizeof(word));
+    word &= mask;
+    result.fill_flips += __builtin_popcountll(word ^ fill_word);
+    result.clear_flips += __builtin_popcountll(word ^ clear_word);
+    result.flips_to_one += __builtin_popcountll(word & ~expected_word & mask);
+    result.flips_to_zero += __builtin_popcountll(~word & expected_word);
+  }
+}
+
+
+
+/* Binary form: "RMB1", then uint32 data frame and unknown frame counts, then
+ * one 12 byte record per line (type, len, uint16 id, 8 bytes), all in host
+ * (little endian) byte order. */
+static int write_binary_dump(const string& path, const ParsedDump& dump, const char *binary_dir)
+{
+  string name = path.substr(path.find_last_of('/') + 1);
+  if (name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0) {
+    name.resize(name.size() - 4);
+  }
+  string binary_path = string(binary_dir) + "/" + name + ".rmb";
+
+  FILE *binary_file = fopen(binary_path.c_str(), "wb");
+  if (binary_file == NULL) {
+    fprintf(stderr, "fopen(%s) failed: %s\n", binary_path.c_str(), strerror(errno));
+    return -1;
+  }
+
+  unsigned int counts[2] = { (unsigned int)dump.data_frames, (unsigned int)dump.unknown_frames };
+  static_assert(sizeof(DumpRecord) == 12);
+  fwrite(ANALYZE_BINARY_MAGIC, 1, 4, binary_file);
+  fwrite(counts, sizeof(counts), 1, binary_file);
+  fwrite(dump.records.data(), sizeof(DumpRecord), dump.records.size(), binary_file);
+
+  if (fclose(binary_file) != 0) {
+    fprintf(stderr, "fclose(%s) failed: %s\n", binary_path.c_str(), strerror(errno));
+    return -1;
+  }
+  return 0;
+}
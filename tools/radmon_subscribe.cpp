@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2025  Richard Loong
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Minimal subscriber for the frame fan-out socket of radmon-client -P.
+ *
+ * Prints one line per published frame: the parse time, the CAN ID and the
+ * data bytes. Records this subscriber missed, because it fell behind or the
+ * publisher's ring overflowed, are reported as they are detected. Doubles as
+ * a reference reader for the wire format in frame_publisher.h.
+ *
+ * Usage: bin/radmon-subscribe SOCKET
+ */
+
+// Includes
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "frame_publisher.h"
+
+using namespace std;
+
+// Constants
+#define SUBSCRIBE_BUFFER_SIZE (sizeof(PublishedBatch) + PUBLISH_BATCH_RECORDS * sizeof(PublishedFrame))
+
+
+
+int main(int argc, char *argv[])
+{
+  struct sockaddr_un address = {};
+  static unsigned char buffer[SUBSCRIBE_BUFFER_SIZE];
+  uint32_t expected_seq = 0;
+  bool is_first = true;
+
+  if (argc != 2 || strlen(argv[1]) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Usage: %s SOCKET\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, argv[1]);
+  if (fd == -1 || connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+    fprintf(stderr, "connect(%s) failed: %s\n", argv[1], strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  while (true) {
+    ssize_t len = recv(fd, buffer, sizeof(buffer), 0);
+    if (len <= 0) {
+      break;
+    }
+
+    PublishedBatch header;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.missed > 0) {
+      printf("# missed %u records\n", header.missed);
+    }
+
+    for (uint32_t k = 0; k < header.count && sizeof(header) + (k + 1) * sizeof(PublishedFrame) <= (size_t)len; k++) {
+      PublishedFrame record;
+      memcpy(&record, buffer + sizeof(header) + k * sizeof(PublishedFrame), sizeof(record));
+      if (!is_first && record.seq != expected_seq) {
+        printf("# sequence gap of %u\n", record.seq - expected_seq);
+      }
+      is_first = false;
+      expected_seq = record.seq + 1;
+      if (record.len > sizeof(record.data)) {
+        printf("# record %u has bad length %u\n", record.seq, record.len);
+        continue;
+      }
+
+      printf("%llu.%06llu ", (unsigned long long)(record.timestamp_ns / 1000000000ULL),
+             (unsigned long long)(record.timestamp_ns % 1000000000ULL / 1000));
+      if (record.flags & PUBLISH_FLAG_DATA) {
+        printf("%03x", record.can_id);
+      } else {
+        printf("???");
+      }
+      for (int i = 0; i < record.len; i++) {
+        printf(" %02x", record.data[i]);
+      }
+      printf("\n");
+    }
+  }
+
+  close(fd);
+  return EXIT_SUCCESS;
+}